@@ -0,0 +1,56 @@
+#include "../include/types.h"
+#include "../include/stdio.h"
+#include "../include/syscall.h"
+#include "../include/string.h"
+
+#define TASK_NR 256
+
+static task_info_t tasks[TASK_NR];
+
+static const char states[] = {
+    'I', //TASK_INIT
+    'R', //TASK_READY
+    'R', //TASK_RUNNING
+    'B', //TASK_BLOCKED
+    'S', //TASK_SLEEPING
+    'W', //TASK_WAITING
+    'Z', //TASK_DEAD
+};
+
+//按照执行过的时间片从多到少排序，时间片相同按照 pid
+static void sort(int count) {
+    for (int i = 1; i < count; ++i) {
+        task_info_t info = tasks[i];
+        int j = i;
+        while (j > 0 && (tasks[j - 1].cpu_ticks < info.cpu_ticks ||
+                         (tasks[j - 1].cpu_ticks == info.cpu_ticks && tasks[j - 1].pid > info.pid))) {
+            tasks[j] = tasks[j - 1];
+            j--;
+        }
+        tasks[j] = info;
+    }
+}
+
+int main(int argc, char const *argv[]) {
+    int count = ps(tasks, TASK_NR);
+    sort(count);
+
+    uint32 total = 0;
+    for (int i = 0; i < count; ++i) {
+        total += tasks[i].cpu_ticks;
+    }
+    total = total ? total : 1;
+
+    printf("  PID  PPID S PRI   CPU   %%CPU   VCSW  IVCSW  BLOCK NAME\n");
+    for (int i = 0; i < count; ++i) {
+        task_info_t *info = &tasks[i];
+        uint32 permille = info->cpu_ticks * 1000 / total;
+        printf("%5d %5d %c %3d %5d %3d.%d %6d %6d %6d %s\n",
+               info->pid, info->ppid,
+               info->state < sizeof(states) ? states[info->state] : '?',
+               info->priority, info->cpu_ticks,
+               permille / 10, permille % 10,
+               info->nvcsw, info->nivcsw, info->block_ticks, info->name);
+    }
+    return 0;
+}
@@ -3,6 +3,16 @@
 #include "../include/assert.h"
 #include "../include/buffer.h"
 
+//根据位图缓冲构造超级块的位图，之后的分配都在同一个位图上扫描，扫描位置得以保留
+void bitmaps_init(super_block_t *sb) {
+    for (size_t i = 0; i < sb->desc->imap_blocks && sb->imaps[i]; ++i) {
+        bitmap_make(&sb->imap_bits[i], sb->imaps[i]->data, BLOCK_SIZE, i * BLOCK_BITS);
+    }
+    for (size_t i = 0; i < sb->desc->zmap_blocks && sb->zmaps[i]; ++i) {
+        bitmap_make(&sb->zmap_bits[i], sb->zmaps[i]->data, BLOCK_SIZE, i * BLOCK_BITS + sb->desc->firstdatazone - 1);
+    }
+}
+
 //分配一个文件块
 uint32 balloc(int32 dev) {
     super_block_t *sb = get_super(dev);//获得该设备的超级块内存对象
@@ -10,16 +20,14 @@ uint32 balloc(int32 dev) {
 
     buffer_t *buf = NULL;
     uint32 bit = EOF;
-    bitmap_t map;
     
-    for (size_t i = 0; i < ZMAP_NR; ++i) {
+    for (size_t i = 0; i < sb->desc->zmap_blocks; ++i) {
         buf = sb->zmaps[i];
         assert(buf);
-        bitmap_make(&map, buf->data, BLOCK_SIZE, i * BLOCK_BITS + sb->desc->firstdatazone - 1);
 
-        bit = bitmap_scan(&map, 1);
+        bit = bitmap_scan(&sb->zmap_bits[i], 1);
         if (bit != EOF) {
-            bwrite(buf);
+            bdirty(buf);
             break;
         }
     }
@@ -30,19 +38,17 @@ uint32 balloc(int32 dev) {
 void bfree(int32 dev, uint32 idx) {//释放该设备中的第idx号文件块
     super_block_t *sb = get_super(dev);
     assert(sb);
-    bitmap_t map;
-    for (size_t i = 0; i < ZMAP_NR; ++i) {
-        if ((i * BLOCK_BITS + sb->desc->firstdatazone - 1) <= idx && idx < ((i + 1) * BLOCK_BITS + sb->desc->firstdatazone - 1)) {
-            buffer_t *buf = sb->zmaps[i];
-            assert(buf);
-            bitmap_make(&map, buf->data, BLOCK_SIZE, i * BLOCK_BITS + sb->desc->firstdatazone - 1);
-            assert(bitmap_test(&map, idx));
-            bitmap_set(&map, idx, false);
-            
-            bwrite(buf);
-            break;
-        }
-    }
+    assert(idx >= sb->desc->firstdatazone - 1);
+    size_t i = (idx - (sb->desc->firstdatazone - 1)) / BLOCK_BITS;
+    assert(i < sb->desc->zmap_blocks);
+
+    buffer_t *buf = sb->zmaps[i];
+    assert(buf);
+    bitmap_t *map = &sb->zmap_bits[i];
+    assert(bitmap_test(map, idx));
+    bitmap_set(map, idx, false);
+
+    bdirty(buf);
 }
 
 //分配一个 inode块
@@ -52,16 +58,14 @@ uint32 ialloc(int32 dev) {
 
     buffer_t *buf = NULL;
     uint32 bit = EOF;
-    bitmap_t map;
     
-    for (size_t i = 0; i < IMAP_NR; ++i) {
+    for (size_t i = 0; i < sb->desc->imap_blocks; ++i) {
         buf = sb->imaps[i];
         assert(buf);
-        bitmap_make(&map, buf->data, BLOCK_SIZE, i * BLOCK_BITS);
 
-        bit = bitmap_scan(&map, 1);
+        bit = bitmap_scan(&sb->imap_bits[i], 1);
         if (bit != EOF) {
-            bwrite(buf);
+            bdirty(buf);
             break;
         }
     }
@@ -72,19 +76,16 @@ uint32 ialloc(int32 dev) {
 void ifree(int32 dev, uint32 idx) {//释放该设备中的第idx号块
     super_block_t *sb = get_super(dev);
     assert(sb);
-    bitmap_t map;
-    for (size_t i = 0; i < IMAP_NR; ++i) {
-        if ((i * BLOCK_BITS) <= idx && idx < ((i + 1) * BLOCK_BITS)) {
-            buffer_t *buf = sb->imaps[i];
-            assert(buf);
-            bitmap_make(&map, buf->data, BLOCK_SIZE, i * BLOCK_BITS);
-            assert(bitmap_test(&map, idx));
-            bitmap_set(&map, idx, false);
-
-            bwrite(buf);
-            break;
-        }
-    }
+    size_t i = idx / BLOCK_BITS;
+    assert(i < sb->desc->imap_blocks);
+
+    buffer_t *buf = sb->imaps[i];
+    assert(buf);
+    bitmap_t *map = &sb->imap_bits[i];
+    assert(bitmap_test(map, idx));
+    bitmap_set(map, idx, false);
+
+    bdirty(buf);
 }
 
 
@@ -112,18 +113,15 @@ static uint32 reckon(inode_t *inode, uint32 block, bool create, int level) {
     while (level >= 0) {
         if (!array[index]) {
             if (!create) {
+                brelease(buf);
                 return 0;
             }
             array[index] = balloc(inode->dev);
-            buf->dirty = true;
+            bdirty(buf);
         }
         brelease(buf);
 
         if (level == 0) {
-            if (inode->buf->dirty) {
-                inode->buf->dirty = false;
-                bwrite(inode->buf);//磁盘和内存的内容保持一致性
-            }
             return array[index];
         }
         
@@ -81,7 +81,16 @@ void dev_init() {
         ++i;
     }
 
-
+    i = 0;
+    while (true) {
+        device = device_find(DEV_INFO, i);
+        if (!device) {
+            break;
+        }
+        sprintf(name, "/dev/%s", device->name);
+        mknod(name, IFCHR | 0444, device->dev);
+        ++i;
+    }
 
     //建立字符设备文件的硬连接
     link("/dev/console", "/dev/stdout");
@@ -4,6 +4,8 @@
 #include "../include/device.h"
 #include "../include/stat.h"
 #include "../include/syscall.h"
+#include "../include/buffer.h"
+#include "../include/memory.h"
 
 #define FILE_NR 128
 
@@ -46,7 +48,7 @@ fd_t sys_open(char *filename, int flags, int mode) {
     if (!inode) {
         return EOF;
     }
-    task_t *task = running_task();
+    task_t *task = running_group();
     fd_t fd = task_get_fd(task);//获取该进程一个空闲的额文件描述符表项的指针
     file_t *file = get_file();//获取一个空闲文件描述符表项
     task->files[fd] =file;
@@ -56,6 +58,8 @@ fd_t sys_open(char *filename, int flags, int mode) {
     file->count = 1;
     file->mode = inode->desc->mode;//文件的属性
     file->offset = 0;//文件偏移量为0 byte
+    file->ra_next = 0;
+    file->ra_end = 0;
 
     if (flags & O_APPEND) {//如果打开时使用的是追加模式
         file->offset = file->inode->desc->size;//偏移量为文件大小
@@ -69,7 +73,7 @@ fd_t sys_creat(char *filename, int mode) {
 
 void sys_close(fd_t fd) {
     assert (fd < TASK_FILE_NR);
-    task_t *task = running_task();
+    task_t *task = running_group();
     file_t *file = task->files[fd];
     if (!file) {
         return;
@@ -80,15 +84,47 @@ void sys_close(fd_t fd) {
 }
 
 
+int sys_fsync(fd_t fd) {
+    if (fd >= TASK_FILE_NR) {
+        return EOF;
+    }
+    file_t *file = running_group()->files[fd];
+    if (!file) {
+        return EOF;
+    }
+    //缓冲不记录属于哪个文件，写回文件所在设备上所有的 dirty 块
+    bsync(file->inode->dev);
+    return 0;
+}
+
+//从文件开头读或者接着上次读的位置读时，在工作线程中预读后面的 READAHEAD_BLOCKS 块，
+//已经预读的部分读掉一半时再预读下一段
+static void file_readahead(file_t *file, uint32 len) {
+    uint32 first = file->offset / BLOCK_SIZE;
+    uint32 last = (file->offset + len - 1) / BLOCK_SIZE;
+    if (file->offset && first != file->ra_next && first + 1 != file->ra_next) {//随机读，停止预读
+        file->ra_end = 0;
+    } else if (file->ra_end < last + 1 + READAHEAD_BLOCKS / 2) {
+        uint32 from = MAX(file->ra_end, last + 1);
+        uint32 end = last + 1 + READAHEAD_BLOCKS;
+        inode_readahead(file->inode, from, end - from);
+        file->ra_end = end;
+    }
+    file->ra_next = last + 1;
+}
+
 //系统调用处理函数read
 int sys_read(fd_t fd, char *buf, int len) {
-    task_t *task = running_task();
+    task_t *task = running_group();
     file_t *file = task->files[fd];
     assert(file);
     assert(len > 0);
     if ((file->flags & O_ACCMODE) == O_WRONLY) {//该文件是以只写方式打开的
         return EOF;
     }
+    if (task->uid != KERNEL_USER && !memory_writable(buf, len)) {//写只读页会触发缺页异常
+        return EOF;
+    }
     int ret = 0;
     inode_t *inode = file->inode;
     if (inode->pipe) {
@@ -96,7 +132,10 @@ int sys_read(fd_t fd, char *buf, int len) {
         return ret;
     } else if (ISCHR(inode->desc->mode)) {
         assert(inode->desc->zone[0]);
-        ret = device_read(inode->desc->zone[0], buf, len, 0, 0);
+        ret = device_read(inode->desc->zone[0], buf, len, file->offset, 0);
+        if (ret > 0) {
+            file->offset += ret;
+        }
         return ret;
     } else if (ISBLK(inode->desc->mode)) {
         assert(inode->desc->zone[0]);
@@ -106,6 +145,7 @@ int sys_read(fd_t fd, char *buf, int len) {
         ret = device_read(inode->desc->zone[0], buf, len / BLOCK_SIZE, file->offset / BLOCK_SIZE, 0);
         return ret;//bug??????????????????
     }
+    file_readahead(file, len);
     ret = inode_read(inode, buf, len, file->offset);
     if (ret != EOF) {
         file->offset += ret;
@@ -115,7 +155,7 @@ int sys_read(fd_t fd, char *buf, int len) {
 
 //系统调用处理函数write
 int sys_write(fd_t fd, char *buf, int len) {
-    task_t *task = running_task();
+    task_t *task = running_group();
     file_t *file = task->files[fd];
     assert(file);
     assert(len > 0);
@@ -150,7 +190,7 @@ int sys_write(fd_t fd, char *buf, int len) {
 int sys_lseek(fd_t fd, off_t offset, int whence) {
     assert(fd < TASK_FILE_NR);
 
-    task_t *task = running_task();
+    task_t *task = running_group();
     file_t *file = task->files[fd];
 
     assert(file);
@@ -180,7 +220,7 @@ int sys_readdir(fd_t fd, dentry_t *dir, uint32 count) {
 }
 
 static fd_t dupfd(fd_t fd, fd_t arg) {
-    task_t *task = running_task();
+    task_t *task = running_group();
     if (fd >= TASK_FILE_NR || !task->files[fd]) {
         return EOF;
     }
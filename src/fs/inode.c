@@ -10,10 +10,19 @@
 #include "../include/memory.h"
 #include "../include/fifo.h"
 #include "../include/arena.h"
+#include "../include/workqueue.h"
 
 #define INODE_NR 64
 
 static inode_t inode_table[INODE_NR];
+static kmem_cache_t *fifo_cache;//管道缓冲队列
+static kmem_cache_t *readahead_cache;//异步预读请求
+
+typedef struct readahead_t {
+    inode_t *inode;
+    uint32 block;
+    uint32 count;
+} readahead_t;
 
 //找到inode_table中没有使用的空inode
 static inode_t *get_free_inode() {
@@ -42,7 +51,7 @@ inode_t *get_pipe_inode() {
     //区别于EOF，这里是无效设备，但是被占用了
     inode->dev = -2;
     //申请内存，表示缓冲队列
-    inode->desc = (inode_desc_t *)kmalloc(sizeof(fifo_t));
+    inode->desc = (inode_desc_t *)kmem_cache_alloc(fifo_cache);
     //管道缓冲区一页内存
     inode->buf = (void *)alloc_kpage(1);
     //两个文件
@@ -64,7 +73,7 @@ static void put_pipe_inode(inode_t *inode) {
     }
     inode->pipe = false;
     //释放描述符 fifo
-    kfree(inode->desc);
+    kmem_cache_free(fifo_cache, inode->desc);
     //释放缓冲区
     free_kpage((uint32)inode->buf, 1);
     //释放inode
@@ -108,17 +117,16 @@ inode_t *iget(int32 dev, uint32 nr) {
     inode_t *inode = find_inode(sb, nr);
     //找到了这个inode
     if (inode) {
-        reentrant_lock(&inode->lock);
-        
         inode->count++;//计数加1
+        read_lock(&inode->lock);//其它进程正在读入这个 inode 时等待读入完成
         inode->atime = time();//访问时间更新
-        reentrant_unlock(&inode->lock);
+        read_unlock(&inode->lock);
         return fit_inode(inode);
     }
     //获得一个空闲的inode
     inode = get_free_inode();
 
-    reentrant_lock(&inode->lock);
+    write_lock(&inode->lock);
     
     inode->dev = dev;
     inode->nr = nr;
@@ -134,7 +142,7 @@ inode_t *iget(int32 dev, uint32 nr) {
     inode->desc = &((inode_desc_t *)buf->data)[((inode->nr - 1) % BLOCK_INODES)];
     inode->ctime = inode->desc->mtime;
 
-    reentrant_unlock(&inode->lock);
+    write_unlock(&inode->lock);
     return inode;
 }
 
@@ -162,16 +170,67 @@ void iput(inode_t *inode) {
 
 
 void inode_init() {
+    fifo_cache = kmem_cache_create("fifo", sizeof(fifo_t), NULL);
+    readahead_cache = kmem_cache_create("readahead", sizeof(readahead_t), NULL);
     for (size_t i = 0; i < INODE_NR; ++i) {
         inode_t *inode = &inode_table[i];
         inode->dev = EOF;
-        reentrant_init(&inode->lock);
-        inode->rxwaiter = NULL;
-        inode->txwaiter = NULL;
+        rwlock_init_name(&inode->lock, "inode");
+        wait_queue_init(&inode->rxwait);
+        wait_queue_init(&inode->txwait);
         inode->pipe = false;
     }
 }
 
+//把文件从 block 开始的 count 个逻辑块读入缓存，物理上连续的块合并成一次磁盘请求
+static void inode_prefetch(inode_t *inode, uint32 block, uint32 count) {
+    uint32 blocks = div_round_up(inode->desc->size, BLOCK_SIZE);
+    if (block >= blocks) {
+        return;
+    }
+    count = MIN(count, blocks - block);
+
+    uint32 start = 0;//连续的一段文件块的起始块号
+    uint32 run = 0;//连续的块数
+    for (uint32 i = block; i < block + count; ++i) {
+        uint32 idx = bmap(inode, i, false);
+        if (idx && run && idx == start + run) {
+            run++;
+            continue;
+        }
+        if (run) {
+            bprefetch(inode->dev, start, run);
+        }
+        start = idx;
+        run = idx ? 1 : 0;//文件空洞不用读
+    }
+    if (run) {
+        bprefetch(inode->dev, start, run);
+    }
+}
+
+static void readahead_work(void *arg) {
+    readahead_t *ra = arg;
+    inode_prefetch(ra->inode, ra->block, ra->count);
+    iput(ra->inode);
+    kmem_cache_free(readahead_cache, ra);
+}
+
+void inode_readahead(inode_t *inode, uint32 block, uint32 count) {
+    if (!ISFILE(inode->desc->mode) || !count || block * BLOCK_SIZE >= inode->desc->size) {
+        return;
+    }
+    readahead_t *ra = kmem_cache_alloc(readahead_cache);
+    ra->inode = inode;
+    ra->block = block;
+    ra->count = count;
+    inode->count++;//预读完成之前 inode 不能被释放
+    if (!queue_work(readahead_work, ra)) {
+        inode->count--;
+        kmem_cache_free(readahead_cache, ra);
+    }
+}
+
 //从inode的offset处，读len个字节到buf
 int inode_read(inode_t *inode, char *buf, uint32 len, off_t offset) {
     assert(ISFILE(inode->desc->mode) || ISDIR(inode->desc->mode));
@@ -184,6 +243,13 @@ int inode_read(inode_t *inode, char *buf, uint32 len, off_t offset) {
     //需要读的字节数
     uint32 left = MIN(len, inode->desc->size - offset);
 
+    //一次读多个块时，先把它们一起读入缓存
+    uint32 first = offset / BLOCK_SIZE;
+    uint32 last = (offset + left - 1) / BLOCK_SIZE;
+    if (last > first) {
+        inode_prefetch(inode, first, last - first + 1);
+    }
+
     while (left) {
         uint32 idx = bmap(inode, offset / BLOCK_SIZE, false);
         assert(idx);
@@ -237,7 +303,7 @@ int inode_write(inode_t *inode, char *buf, uint32 len, off_t offset) {
         
         //拷贝内容
         memcpy(ptr, buf, chars);
-        bf->dirty = true;
+        bdirty(bf);
         brelease(bf);
 
         left -= chars;
@@ -247,7 +313,8 @@ int inode_write(inode_t *inode, char *buf, uint32 len, off_t offset) {
     
     inode->desc->size = MAX(offset, inode->desc->size);
     inode->desc->mtime = inode->atime = time();
-    bwrite(inode->buf);
+    bdirty(inode->buf);
+    page_cache_invalidate(inode, begin, offset);
     
     return offset - begin;
 }
@@ -271,6 +338,7 @@ static void inode_bfree(inode_t *inode, uint16 *array, int index, int level) {
 }
 
 void inode_truncate(inode_t *inode) {
+    page_cache_invalidate(inode, 0, inode->desc->size);
     if (!ISFILE(inode->desc->mode) || !ISDIR(inode->desc->mode)) {
         return;
     }
@@ -287,14 +355,14 @@ void inode_truncate(inode_t *inode) {
     
     inode->desc->size = 0;
     inode->desc->mtime = inode->atime = time();
-    bwrite(inode->buf);
+    bdirty(inode->buf);
 }
 
 inode_t *new_inode(int32 dev, uint32 nr) {
-    task_t *task = running_task();
+    task_t *task = running_group();
     inode_t *inode = iget(dev, nr);
 
-    inode->buf->dirty = true;
+    bdirty(inode->buf);
     inode->desc->mode = 0777 & (~task->umask);
     inode->desc->uid = task->uid;
     inode->desc->size = 0;
@@ -19,7 +19,7 @@ bool permission(inode_t *inode, uint16 mask)//mask为想要获得的权限
     if (!inode->desc->nlinks)//当前inode的硬链接数为0
         return false;
 
-    task_t *task = running_task();
+    task_t *task = running_group();
     if (task->uid == KERNEL_USER)//如果是内核用户，直接返回true
         return true;
 
@@ -118,13 +118,12 @@ static buffer_t *add_entry(inode_t *dir, const char *name, dentry_t **result) {
         if (i * sizeof(dentry_t) >= dir->desc->size) {
             dir->desc->size = (i + 1) * sizeof(dentry_t);
             dir->desc->mtime = time();
-            // dir->buf->dirty = true;
-            bwrite(dir->buf);
+            bdirty(dir->buf);
             
             entry->nr = 0;
 
             strncpy(entry->name, name, NAME_LEN);
-            buf->dirty = true;
+            bdirty(buf);
             
             *result = entry;
             return buf;
@@ -134,7 +133,7 @@ static buffer_t *add_entry(inode_t *dir, const char *name, dentry_t **result) {
 
 //获取pathname对应的父目录（base) inode
 inode_t *named(char *pathname, char **next) {//next用于携带文件名字符串返回参数
-    task_t *task = running_task();
+    task_t *task = running_group();
     char *left = pathname;
     inode_t *inode = NULL;
 
@@ -234,20 +233,20 @@ int sys_mkdir(char *pathname, int mode) {
     }
 
     bf = add_entry(dir, name, &entry);//添加目录
-    bf->dirty = true;
+    bdirty(bf);
     entry->nr = ialloc(dir->dev);//分配一个inode，返回值为inode的序号
     
-    task_t *task = running_task();
+    task_t *task = running_group();
     inode_t *inode = new_inode(dir->dev, entry->nr);//获得新添加目录对应的inode
     
     inode->desc->mode = (mode & 0777 & ~task->umask) | IFDIR;
     inode->desc->size = sizeof(dentry_t) * 2; //当前目录和父目录 两个目录的大小
     inode->desc->nlinks = 2;
-    bwrite(inode->buf);
+    bdirty(inode->buf);
 
     //写入inode目录中的默认目录项
     buffer_t *zbuf = bread(inode->dev, bmap(inode, 0, true));
-    zbuf->dirty = true;
+    bdirty(zbuf);
     entry = (dentry_t *)zbuf->data;
 
     strcpy(entry->name, ".");
@@ -259,7 +258,7 @@ int sys_mkdir(char *pathname, int mode) {
 
     //父目录链接数加1
     dir->desc->nlinks++;
-    bwrite(dir->buf);
+    bdirty(dir->buf);
 
     iput(inode);
     iput(dir);
@@ -329,9 +328,9 @@ int sys_rmdir(char *pathname) {
 
     inode = iget(dir->dev, entry->nr);
     entry->nr = 0;//该目录项失效
-    bf->dirty = true;
+    bdirty(bf);
     
-    task_t *task = running_task();
+    task_t *task = running_group();
     if (!ISDIR(inode->desc->mode) || (dir->desc->mode & ISVTX) && (task->uid != inode->desc->uid)) {//不是目录 或 受限删除
         goto rollback;
     }
@@ -345,7 +344,7 @@ int sys_rmdir(char *pathname) {
     dir->desc->nlinks--;
     dir->ctime = dir->atime = dir->desc->mtime = time();
     // dir->desc->size -= sizeof(dentry_t);删除目录时，文件大小不变
-    bwrite(dir->buf);
+    bdirty(dir->buf);
 
     ret = 0;
 rollback:
@@ -388,11 +387,11 @@ int sys_link(char *oldname, char *newname) {
     //添加目录项
     buf = add_entry(dir, name, &entry);
     entry->nr = inode->nr;
-    buf->dirty = true;
+    bdirty(buf);
 
     inode->desc->nlinks++;
     inode->ctime = time();
-    bwrite(inode->buf);
+    bdirty(inode->buf);
     ret = 0;
 rollback:
     brelease(buf);
@@ -424,17 +423,16 @@ int sys_unlink(char *filename) {
         goto rollback;
     }
 
-    task_t *task = running_task();
+    task_t *task = running_group();
     if ((inode->desc->mode & ISVTX) && task->uid != inode->desc->uid) {
         goto rollback;
     }
 
     entry->nr = 0;
-    buf->dirty = true;
+    bdirty(buf);
 
     inode->desc->nlinks--;
-    // inode->buf->dirty = true;
-    bwrite(inode->buf);
+    bdirty(inode->buf);
     if (inode->desc->nlinks == 0) {
         inode_truncate(inode);
         ifree(inode->dev, inode->nr);
@@ -442,7 +440,7 @@ int sys_unlink(char *filename) {
 
     dir->ctime = dir->atime = dir->desc->mtime = time();
     // dir->desc->size -= sizeof(dentry_t);删除一个目录项，目录大小不变
-    bwrite(dir->buf);
+    bdirty(dir->buf);
     ret = 0;
 rollback:
     brelease(buf);
@@ -483,18 +481,18 @@ inode_t *inode_open(char *pathname, int flag, int mode) {
     }
 
     buf = add_entry(dir, name, &entry);//在dir下添加目录
-    buf->dirty = true;
+    bdirty(buf);
     entry->nr = ialloc(dir->dev);//分配一个inode块
     inode = new_inode(dir->dev, entry->nr);//获取新建文件的inode
 
-    task_t *task = running_task();
+    task_t *task = running_group();
     //准备创建文件
     mode &= (0777 & ~task->umask);//创建的文件的属性
     mode |= IFREG; //文件类型
 
     inode->desc->mode = mode;
 
-    bwrite(inode->buf);
+    bdirty(inode->buf);
 makeup:
     if (!permission(inode, ACC_MODE(flag && O_ACCMODE))) {
         goto rollback;
@@ -521,7 +519,7 @@ rollback:
 
 //获取当前路径
 char *sys_getcwd(char *buf, size_t size) {
-    task_t *task = running_task();
+    task_t *task = running_group();
     strncpy(buf, task->pwd, size);
     return buf;
 }
@@ -598,7 +596,7 @@ static void abspath(char *pwd, const char *pathname)
 
 //切换当前目录
 int sys_chdir(char *pathname) {
-    task_t *task = running_task();
+    task_t *task = running_group();
     inode_t *inode = namei(pathname);
     if (!inode) {//找不到inode
         goto rollback;
@@ -619,7 +617,7 @@ rollback:
 
 //切换根目录
 int sys_chroot(char *pathname) {
-    task_t *task = running_task();
+    task_t *task = running_group();
     inode_t *inode = namei(pathname);
     if (!inode) {//找不到inode
         goto rollback;
@@ -664,7 +662,7 @@ int sys_mknod(char *filename, int mode, int dev) {
         goto rollback;
     }
     buf = add_entry(dir, name, &entry);//添加目录
-    buf->dirty = true;
+    bdirty(buf);
     entry->nr = ialloc(dir->dev);
     inode = new_inode(dir->dev, entry->nr);
 
@@ -672,7 +670,7 @@ int sys_mknod(char *filename, int mode, int dev) {
     if (ISBLK(mode) || ISCHR(mode)) {//字符设备或者块设备文件
         inode->desc->zone[0] = dev;
     }
-    bwrite(inode->buf);
+    bdirty(inode->buf);
 
     ret = 0;
 rollback:
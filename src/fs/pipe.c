@@ -14,16 +14,13 @@ int pipe_read(inode_t *inode, char *buf, int count) {
     fifo_t *fifo = (fifo_t *)inode->desc;
     int nr = 0;
     while (nr < count) {
-        if (fifo_empty(fifo)) {
-            assert(inode->rxwaiter == NULL);
-            inode->rxwaiter = running_task();
-            task_block(inode->rxwaiter, NULL, TASK_BLOCKED);
+        while (fifo_empty(fifo)) {//被唤醒时数据可能已经被别的读进程取走了
+            if (!wait_sleep_killable(&inode->rxwait)) {//进程正在退出
+                return nr;
+            }
         }
         buf[nr++] = fifo_get(fifo);
-        if (inode->txwaiter) {
-            task_unblock(inode->txwaiter);
-            inode->txwaiter = NULL;
-        }
+        wake_one(&inode->txwait);//空出了一个位置
     }
     return nr;
 }
@@ -32,16 +29,13 @@ int pipe_write(inode_t *inode, char *buf, int count) {
     fifo_t *fifo = (fifo_t *)inode->desc;
     int nr = 0;
     while (nr < count) {
-        if (fifo_full(fifo)) {
-            assert(inode->txwaiter == NULL);
-            inode->txwaiter = running_task();
-            task_block(inode->txwaiter, NULL, TASK_BLOCKED);
+        while (fifo_full(fifo)) {//被唤醒时空位可能已经被别的写进程占用了
+            if (!wait_sleep_killable(&inode->txwait)) {//进程正在退出
+                return nr;
+            }
         }
         fifo_put(fifo, buf[nr++]);
-        if (inode->rxwaiter) {
-            task_unblock(inode->rxwaiter);
-            inode->rxwaiter = NULL;
-        }
+        wake_one(&inode->rxwait);//有了一个字符
     }
     return nr;
 }
@@ -50,7 +44,7 @@ int pipe_write(inode_t *inode, char *buf, int count) {
 int sys_pipe(fd_t pipefd[2]) {
     inode_t *inode = get_pipe_inode();
 
-    task_t *task = running_task();
+    task_t *task = running_group();
     file_t *files[2];
 
     pipefd[0] = task_get_fd(task);
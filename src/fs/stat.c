@@ -31,7 +31,7 @@ int sys_fstat(fd_t fd, stat_t *statbuf) {
     if (fd > TASK_FILE_NR) {
         return EOF;
     }
-    task_t *task = running_task();
+    task_t *task = running_group();
     file_t *file = task->files[fd];
     if (!file) {
         return EOF;
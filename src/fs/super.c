@@ -99,6 +99,7 @@ super_block_t *read_super(int32 dev) { // 读取 dev 对应的超级块
             break;
         }
     }
+    bitmaps_init(sb);
     return sb;
 }
 
@@ -213,6 +214,9 @@ int sys_umount(char *target) {
 rollback:
     put_super(sb);
     iput(inode);
+    if (!ret) {//卸载之后设备上的 dirty 块全部写回
+        bsync(dev);
+    }
     return ret;
 }
 
@@ -236,7 +240,7 @@ int devmkfs(int32 dev, uint32 icount)
 
     buf = bread(dev, 1);
     sb->buf = buf;
-    buf->dirty = true;
+    bdirty(buf);
 
     // 初始化超级块
     super_desc_t *desc = (super_desc_t *)buf->data;
@@ -264,7 +268,7 @@ int devmkfs(int32 dev, uint32 icount)
         if ((sb->imaps[i] = bread(dev, idx)))
         {
             memset(sb->imaps[i]->data, 0, BLOCK_SIZE);
-            sb->imaps[i]->dirty = true;
+            bdirty(sb->imaps[i]);
             idx++;
         }
         else
@@ -273,11 +277,12 @@ int devmkfs(int32 dev, uint32 icount)
         if ((sb->zmaps[i] = bread(dev, idx)))
         {
             memset(sb->zmaps[i]->data, 0, BLOCK_SIZE);
-            sb->zmaps[i]->dirty = true;
+            bdirty(sb->zmaps[i]);
             idx++;
         }
         else
             break;
+    bitmaps_init(sb);
 
     // 初始化位图
     idx = balloc(dev);
@@ -299,7 +304,7 @@ int devmkfs(int32 dev, uint32 icount)
     {
         int count = counts[i];
         buffer_t *map = maps[i];
-        map->dirty = true;
+        bdirty(map);
         int offset = count % (BLOCK_BITS);
         int begin = (offset / 8);
         char *ptr = (char *)map->data + begin;
@@ -316,7 +321,7 @@ int devmkfs(int32 dev, uint32 icount)
     }
 
     // 创建根目录
-    task_t *task = running_task();
+    task_t *task = running_group();
 
     inode_t *iroot = new_inode(dev, 1);
     sb->iroot = iroot;
@@ -326,7 +331,7 @@ int devmkfs(int32 dev, uint32 icount)
     iroot->desc->nlinks = 2;                  // 一个是 '.' 一个是 name
 
     buf = bread(dev, bmap(iroot, 0, true));
-    buf->dirty = true;
+    bdirty(buf);
 
     dentry_t *entry = (dentry_t *)buf->data;
     memset(entry, 0, BLOCK_SIZE);
@@ -3,25 +3,46 @@
 
 #include "list.h"
 
-#define DESC_COUNT 7
+#define DESC_COUNT 7 //kmalloc 使用的 2 的幂大小描述符数量 16byte ~ 1024byte
+#define CACHE_NR 32 //最多支持的描述符(缓存)数量，包括 kmalloc 使用的描述符
+#define CACHE_NAMELEN 16 //缓存名称长度
 
-//内存描述符
+typedef void (*kmem_ctor_t)(void *obj);
+
+//内存描述符(对象缓存)
 typedef struct arena_descriptor_t {
+    char name[CACHE_NAMELEN];//缓存名称
     uint32 total_block;//一页内存分成了多少块
     uint32 block_size;//块大小
-    list_t free_list;//空闲列表
+    uint32 block_offset;//第一块在 arena 中的偏移，arena 头和第一块之间是每一块的分配调用点编号
+    list_t free_list;//还有空闲块的 arena 链表
+    kmem_ctor_t ctor;//对象构造函数，每次分配对象时调用，可以为 NULL
+    uint32 inuse;//使用中的块数
+    uint32 arenas;//已分配的 arena 页数
 } arena_descriptor_t;
 
+typedef arena_descriptor_t kmem_cache_t;
+
 //一页或者多页
 typedef struct arena_t {
     arena_descriptor_t *desc;// 该arena的描述符
     uint32 count;// 当large = flase时，表示该页的剩余块数;当large = true时,表示该arena管理的页数
     uint32 large;// (是不是超过了大小)为true时，desc字段为NULL
     uint32 magic;// 魔术
+    void *free;// 空闲块链表，链表指针保存在空闲块的开头
+    list_node_t node;// arena 在描述符 free_list 中的结点
+    uint8 site;// large 为 true 时，分配的调用点编号
 } arena_t;
 
 void *kmalloc(size_t size);
 void kfree(void *ptr);
 void arena_init();
 
-#endif
\ No newline at end of file
+//创建一个对象大小为 size 的缓存
+kmem_cache_t *kmem_cache_create(char *name, size_t size, kmem_ctor_t ctor);
+//从缓存中分配一个对象
+void *kmem_cache_alloc(kmem_cache_t *cache);
+//将对象释放回缓存
+void kmem_cache_free(kmem_cache_t *cache, void *ptr);
+
+#endif
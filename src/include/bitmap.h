@@ -8,6 +8,7 @@ typedef struct bitmap_t
     uint8 *bits;//位图缓冲区
     uint32 length;//位图缓冲区长度
     uint32 offset; //位图开始的偏移
+    uint32 hint; //该位之前的位都已经被占用，扫描从这里开始
 } bitmap_t;
 
 //构造位图，但是不清空bits指向的内容
@@ -25,4 +26,7 @@ void bitmap_set(bitmap_t *map, uint32 index, bool value);
 //从位图中得到连续的count位
 int bitmap_scan(bitmap_t *map, uint32 count);
 
+//从 from 开始找到一个空闲位并置 1，到末尾后回到开头继续找，没有空闲位返回 EOF
+int bitmap_alloc_from(bitmap_t *map, uint32 from);
+
 #endif
\ No newline at end of file
@@ -15,15 +15,24 @@ typedef struct buffer_t
     uint32 block;       // 对应设备的块号
     int count;         // 引用计数
     list_node_t hnode; // 哈希表拉链节点
-    list_node_t rnode; // 缓冲节点
-    reentrantlock_t lock;       // 锁
+    list_node_t rnode; // LRU 链表节点，没有进程引用时在链表中
+    rwlock_t lock;     // 读写锁，读入数据时持有写锁
     bool dirty;        // 是否与磁盘不一致
+    uint32 dirtied;    // 变为 dirty 时的全局时间片
     bool valid;        // 是否有效
 } buffer_t;
 
-void bwrite(buffer_t *bf);//线程不安全
+void bwrite(buffer_t *bf);//立即写入磁盘，线程不安全
+void bdirty(buffer_t *bf);//标记为 dirty，由后台定期写回
+void bsync(int32 dev);//写回设备 dev 所有 dirty 块，dev 为 EOF 时写回所有设备
+void bprefetch(int32 dev, uint32 block, uint32 count);//把设备上连续的 count 块读入缓存，缺失的连续块合并为一次磁盘请求，不等待
 buffer_t *bread(int32 dev, uint32 block);//线程安全
 void brelease(buffer_t *bf);//线程安全
 
+int sys_sync();
+
+//释放最多 count 页没有被引用并且干净的缓存，返回释放的页数，内核页不够时调用
+uint32 buffer_shrink(uint32 count);
+
 void buffer_init();
 #endif
\ No newline at end of file
@@ -6,6 +6,12 @@ extern uint32 jiffy;//一个时间片10ms
 
 void clock_init();
 void start_beep();
+
+//只剩 idle 可以执行时，将时钟改为单次模式，到下一个定时器到期才中断
+void clock_idle_enter();
+
+//被其它中断唤醒之后，补上已经经过的时间片，恢复周期模式
+void clock_idle_exit();
 time_t sys_time();//time系统调用处理函数
 
 #endif
\ No newline at end of file
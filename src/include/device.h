@@ -19,6 +19,7 @@ enum device_subtype_t {
     DEV_IDE_DISK, //IDE磁盘
     DEV_IDE_PART, //IDE分区
     DEV_RAMDISK, //虚拟磁盘
+    DEV_INFO, //内核信息
 };
 
 //设备控制命令
@@ -2,7 +2,9 @@
 #define _FS_H_
 #include "list.h"
 #include "mutex.h"
+#include "wait.h"
 #include "stat.h"
+#include "bitmap.h"
 
 #define BLOCK_SIZE 1024 // 块大小
 #define SECTOR_SIZE 512 // 扇区大小
@@ -16,6 +18,7 @@
 #define BLOCK_BITS (BLOCK_SIZE * 8)  //块位图大小
 #define BLOCK_INODES (BLOCK_SIZE / sizeof(inode_desc_t)) //块 inode 数量
 #define BLOCK_DENTRIES (BLOCK_SIZE / sizeof(dentry_t)) // 块 dentry 数量
+#define READAHEAD_BLOCKS 16 // 顺序读文件时预读的块数
 #define BLOCK_INDEXES (BLOCK_SIZE / sizeof(uint16)) //块索引数量
 
 #define DIRECT_BLOCK (7)  //直接块数量
@@ -64,11 +67,11 @@ typedef struct inode_t
     uint32 count;            // 引用计数
     time_t atime;         // 访问时间
     time_t ctime;         // 修改时间
-    struct reentrantlock_t lock;       // 锁
+    struct rwlock_t lock; // 读写锁，读入描述符时持有写锁
     list_node_t node;     // 链表结点
     int32 mount;          // 安装设备
-    struct task_t *rxwaiter;//读等待进程
-    struct task_t *txwaiter;//写等待进程
+    wait_queue_t rxwait;//读等待队列
+    wait_queue_t txwait;//写等待队列
     bool pipe;//管道标志
 } inode_t;
 
@@ -92,6 +95,8 @@ typedef struct super_block_t
     struct buffer_t *buf;            // 超级块描述符 buffer
     struct buffer_t *imaps[IMAP_NR]; // inode 位图缓冲
     struct buffer_t *zmaps[ZMAP_NR]; // 块位图缓冲
+    bitmap_t imap_bits[IMAP_NR];     // inode 位图，常驻以保留扫描位置
+    bitmap_t zmap_bits[ZMAP_NR];     // 块位图，常驻以保留扫描位置
     int32 dev;                       // 设备号
     uint32 count;                    // 引用计数
     list_t inode_list;               // 使用中 inode 链表
@@ -114,6 +119,8 @@ typedef struct file_t
     inode_t *inode; // 文件 inode
     uint32 count;      // 引用计数(多少个进程使用了这个文件描述符)
     off_t offset;   // 文件偏移
+    uint32 ra_next; // 顺序读时下一次读的文件块
+    uint32 ra_end;  // 已经预读到的文件块，0 表示没有在预读
     int flags;      // 文件标记
     int mode;       // 文件模式
 } file_t;
@@ -130,6 +137,7 @@ typedef enum whence_t {
 void super_init();
 super_block_t *get_super(int32 dev);
 super_block_t *read_super(int32 dev); // 读取 dev 对应的超级块
+void bitmaps_init(super_block_t *sb); // 根据位图缓冲构造超级块的位图
 //挂载设备
 int sys_mount(char *devname, char *dirname, int flags);
 //卸载设备
@@ -159,6 +167,8 @@ inode_t *iget(int32 dev, uint32 nr);//获得设备dev的nr inode（线程安全
 void iput(inode_t *inode); //释放inode
 //从inode的offset处，读len个字节到buf
 int inode_read(inode_t *inode, char *buf, uint32 len, off_t offset);
+//在工作线程中把文件从 block 开始的 count 个逻辑块预读到缓存
+void inode_readahead(inode_t *inode, uint32 block, uint32 count);
 //从inode的offset处，将buf个字节写入磁盘
 int inode_write(inode_t *inode, char *buf, uint32 len, off_t offset);
 //释放inode所有文件块
@@ -220,6 +230,7 @@ fd_t sys_creat(char *filename, int mode);
 void sys_close(fd_t fd);
 //系统调用处理函数read
 int sys_read(fd_t fd, char *buf, int len);
+int sys_fsync(fd_t fd);
 //系统调用处理函数write
 int sys_write(fd_t fd, char *buf, int len);
 //系统调用处理函数lseek
@@ -2,6 +2,7 @@
 #define _IDE_H_
 
 #include "mutex.h"
+#include "wait.h"
 
 #define SECTOR_SIZE 512 // 扇区大小
 
@@ -83,7 +84,7 @@ typedef struct ide_ctrl_t
     ide_disk_t disks[IDE_DISK_NR]; // 磁盘
     ide_disk_t *active;            // 当前选择的磁盘
     uint8 control;
-    task_t *waiter; //等待控制器的进程
+    wait_queue_t wait; //等待控制器中断的进程
 } ide_ctrl_t;
 
 extern ide_ctrl_t controllers[IDE_CTRL_NR];
@@ -0,0 +1,12 @@
+#ifndef INFO_H
+#define INFO_H
+
+#include "types.h"
+
+//将内核信息以文本形式写入 buf(一页大小)，返回写入的长度
+typedef int (*info_show_t)(char *buf);
+
+//安装一个只读的内核信息字符设备，dev_init 会在 /dev 下为其创建同名文件
+int32 info_install(char *name, info_show_t show);
+
+#endif
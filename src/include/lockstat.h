@@ -0,0 +1,28 @@
+#ifndef _LOCKSTAT_H_
+#define _LOCKSTAT_H_
+
+#include "types.h"
+
+#define LOCKSTAT_NAMELEN 16
+
+//锁统计，同名的锁共用一份统计
+typedef struct lock_stat_t {
+    char name[LOCKSTAT_NAMELEN];//锁名称
+    uint32 acquires;//持有次数
+    uint32 contends;//需要等待才持有的次数
+    uint32 wait;//等待的总时间片
+    uint32 hold_max;//最长持有的时间片
+} lock_stat_t;
+
+void lockstat_init();
+
+//根据名称得到锁统计，不存在则新建，统计表已满返回 NULL
+lock_stat_t *lockstat_get(char *name);
+
+//记录一次持有，contended 表示是否等待过，wait 为等待的时间片
+void lockstat_acquire(lock_stat_t *stat, bool contended, uint32 wait);
+
+//记录一次释放，hold 为持有的时间片
+void lockstat_release(lock_stat_t *stat, uint32 hold);
+
+#endif
@@ -6,17 +6,11 @@
 #define PAGE_SIZE 0x1000     // 一页的大小 4K
 #define MEMORY_BASE 0x100000 // 1M，可用内存开始的位置
 
-//内核占用的内存大小 16M 其中8~12M 为磁盘高速缓冲区
+//内核占用的内存大小 16M 其中12~16M 为内存虚拟磁盘，磁盘高速缓冲区从内核页中分配
 #define KERNEL_MEMORY_SIZE 0x1000000
 
-//内核高速缓冲地址
-#define KERNEL_BUFFER_MEM 0x800000
-
-//内核高速缓冲大小
-#define KERNEL_BUFFER_SIZE 0x400000
-
 //内存虚拟磁盘地址
-#define KERNEL_RAMDISK_MEM (KERNEL_BUFFER_MEM + KERNEL_BUFFER_SIZE)
+#define KERNEL_RAMDISK_MEM 0xC00000
 
 //内存虚拟磁盘大小
 #define KERNEL_RAMDISK_SIZE 0x400000
@@ -73,12 +67,24 @@ void set_cr3(uint32 pde);
 //开启分页
 void mapping_init();
 
+//分配 2^order 个连续的物理页，返回物理地址
+uint32 get_pages(uint32 order);
+
+//释放 2^order 个连续的物理页
+void put_pages(uint32 addr, uint32 order);
+
 //分配count个连续的内核页
 uint32 alloc_kpage(uint32 count);
 
 //释放个连续的内核页
 void free_kpage(uint32 vaddr, uint32 count);
 
+//空闲的内核页数
+uint32 kpage_available();
+
+//启动命令行中 name=大小 的值，可以带 K 或 M 后缀，返回字节数，没有时返回 size
+uint32 cmdline_size(const char *name, uint32 size);
+
 //获取页表项
 page_entry_t *get_entry(uint32 vaddr, bool create);
 
@@ -91,8 +97,17 @@ void link_page(uint32 vaddr);
 //去掉vaddr对应的物理内存映射
 void unlink_page(uint32 vaddr);
 
+//当前进程 [addr, addr + len) 是否是内核可以写入的用户内存，系统调用写用户缓冲区之前检查
+bool memory_writable(void *addr, uint32 len);
+
+//去掉 [start, end) 的物理内存映射，并释放空的页表
+void unlink_range(uint32 start, uint32 end);
+
 page_entry_t *copy_pde();
 
+//释放当前进程还与其他进程共享的页表
+void free_shared_pte();
+
 void page_fault(uint32 vector, uint32 edi, uint32 esi, uint32 ebp, uint32 esp, 
                         uint32 ebx, uint32 edx, uint32 ecx, uint32 eax,
                         uint32 gs, uint32 fs, uint32 es, uint32 ds,
@@ -107,4 +122,21 @@ void *sys_mmap(void *addr, size_t length, int prot, int flags, int fd, off_t off
 
 int sys_munmap(void *addr, size_t length);
 
+int sys_msync(void *addr, size_t length, int flags);
+
+struct task_t;
+struct inode_t;
+
+//为当前进程添加映射区域 [start, end)，缺页时从 inode 的 offset 处读取，inode 为 NULL 时是匿名区域
+struct vm_region_t *region_add(uint32 start, uint32 end, struct inode_t *inode, uint32 offset, uint32 filesz, uint32 flags);
+
+//fork 时子进程复制了父进程的区域，增加区域文件的引用
+void region_copy(struct task_t *task);
+
+//释放进程所有的文件映射区域
+void region_free(struct task_t *task);
+
+//文件内容 [start, end) 被修改，丢弃页缓存中对应的页
+void page_cache_invalidate(struct inode_t *inode, uint32 start, uint32 end);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,24 @@
+#ifndef _MEMSTAT_H_
+#define _MEMSTAT_H_
+
+#include "types.h"
+
+//统计的分配类型
+typedef enum memstat_type_t {
+    MEMSTAT_KMALLOC, //kmalloc / kmem_cache_alloc，以块计数
+    MEMSTAT_KPAGE,   //alloc_kpage，以页计数
+    MEMSTAT_PAGE,    //get_page / get_pages，以页计数
+    MEMSTAT_TYPE_NR,
+} memstat_type_t;
+
+#define MEMSTAT_UNKNOWN 0 //调用点表已满时使用的调用点编号
+
+void memstat_init();
+
+//记录调用点 caller 分配了 count 个单位，返回调用点编号，释放时原样交回
+uint8 memstat_alloc(memstat_type_t type, uint32 caller, uint32 count);
+
+//调用点 site 释放了 count 个单位
+void memstat_free(memstat_type_t type, uint8 site, uint32 count);
+
+#endif
@@ -7,6 +7,7 @@
 #define MULTIBOOT2_MAGIC 0x36d76289
 
 #define MULTIBOOT_TAG_TYPE_END 0
+#define MULTIBOOT_TAG_TYPE_CMDLINE 1
 #define MULTIBOOT_TAG_TYPE_MMAP 6
 
 //内存type类型
@@ -23,6 +24,14 @@ typedef struct multi_tag_t
     uint32 size;
 } multi_tag_t;
 
+// multiboot 启动命令行 tag
+typedef struct multi_tag_string_t
+{
+    uint32 type;
+    uint32 size;
+    char string[0];
+} multi_tag_string_t;
+
 // multiboot mmap entry
 typedef struct multi_mmap_entry_t
 {
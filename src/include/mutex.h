@@ -3,17 +3,25 @@
 
 #include "list.h"
 #include "tasks.h"
+#include "lockstat.h"
+#include "wait.h"
 
 typedef struct mutex_t
 {
     bool value;     // 信号量
-    list_t waiters; // 等待队列
+    wait_queue_t waiters; // 等待队列
+    task_t *holder; // 持有者，持有期间优先级不低于等待者中最高的优先级
+    list_node_t node; // 持有者的互斥量链表节点
+    lock_stat_t *stat; // 锁统计，NULL 表示不统计
+    uint32 since;   // 持有时的全局时间片
 } mutex_t;
 
 
 void mutex_init(mutex_t *mutex);   // 初始化互斥量
+void mutex_init_name(mutex_t *mutex, char *name); // 初始化互斥量，并以 name 统计加锁情况
 void mutex_lock(mutex_t *mutex);   // 尝试持有互斥量
 void mutex_unlock(mutex_t *mutex); // 释放互斥量
+void mutex_unlock_noyield(mutex_t *mutex); // 释放互斥量，只唤醒等待者，不让出执行权
 
 typedef struct reentrantlock_t {
     task_t *holder;//持有者
@@ -23,7 +31,42 @@ typedef struct reentrantlock_t {
 
 
 void reentrant_init(reentrantlock_t *lock);//可重入锁初始化
+void reentrant_init_name(reentrantlock_t *lock, char *name);//可重入锁初始化，并以 name 统计加锁情况
 void reentrant_lock(reentrantlock_t *lock);//加锁
 void reentrant_unlock(reentrantlock_t *lock);//解锁
 
+typedef struct semaphore_t {
+    int32 value;//剩余的资源数量
+    wait_queue_t waiters;//等待队列
+} semaphore_t;//计数信号量
+
+void sema_init(semaphore_t *sema, int32 value);//初始化信号量
+void sema_down(semaphore_t *sema);//P 操作，没有资源时阻塞
+void sema_up(semaphore_t *sema);//V 操作，唤醒一个等待者
+
+typedef struct cond_t {
+    wait_queue_t waiters;//等待队列
+} cond_t;//条件变量，和互斥量一起使用
+
+void cond_init(cond_t *cond);//初始化条件变量
+void cond_wait(cond_t *cond, mutex_t *mutex);//释放互斥量并等待，被唤醒后重新持有互斥量
+void cond_signal(cond_t *cond);//唤醒一个等待者
+void cond_broadcast(cond_t *cond);//唤醒所有等待者
+
+typedef struct rwlock_t {
+    uint32 readers;//持有读锁的数量
+    bool writer;//是否有写者持有
+    wait_queue_t rwaiters;//等待读的队列
+    wait_queue_t wwaiters;//等待写的队列
+    lock_stat_t *stat;//锁统计，NULL 表示不统计
+    uint32 since;//写者持有时的全局时间片
+} rwlock_t;//读写锁，读者可以同时持有，有写者等待时新的读者要等待
+
+void rwlock_init(rwlock_t *lock);//读写锁初始化
+void rwlock_init_name(rwlock_t *lock, char *name);//读写锁初始化，并以 name 统计加锁情况，持有时间只统计写者
+void read_lock(rwlock_t *lock);//加读锁
+void read_unlock(rwlock_t *lock);//解读锁
+void write_lock(rwlock_t *lock);//加写锁
+void write_unlock(rwlock_t *lock);//解写锁
+
 #endif
\ No newline at end of file
@@ -24,6 +24,7 @@ typedef enum syscall_t {
     SYS_NR_GETPID = 20,
     SYS_NR_MOUNT = 21,
     SYS_NR_UMOUNT = 22,
+    SYS_NR_SYNC = 36,
     SYS_NR_FSTAT = 28,
     SYS_NR_MKDIR = 39,
     SYS_NR_RMDIR = 40,
@@ -37,11 +38,16 @@ typedef enum syscall_t {
     SYS_NR_READDIR = 89,
     SYS_NR_MMAP = 90,
     SYS_NR_MUNMAP = 91,
+    SYS_NR_FSYNC = 118,
+    SYS_NR_CLONE = 120,
+    SYS_NR_MSYNC = 144,
     SYS_NR_SLEEP = 158,
     SYS_NR_YIELD = 162,
     SYS_NR_GETCWD = 183,
+    SYS_NR_FUTEX = 240,
     SYS_NR_CLEAR = 200, 
     SYS_NR_MKFS = 201,
+    SYS_NR_PS = 202,
 }syscall_t;
 
 
@@ -55,8 +61,31 @@ enum mmap_type_t {
     MAP_SHARED = 1,
     MAP_PRIVATE = 2,
     MAP_FIXED =  0x10,
+    //msync flags
+    MS_ASYNC = 1,
+    MS_INVALIDATE = 2,
+    MS_SYNC = 4,
 };
 
+enum futex_op_t {
+    FUTEX_WAIT = 0, //*addr 等于 val 时睡眠
+    FUTEX_WAKE = 1, //最多唤醒 val 个等待 addr 的线程
+};
+
+//ps 系统调用返回的进程信息
+typedef struct task_info_t {
+    pid_t pid;
+    pid_t ppid;
+    uint32 state; //task_state_t
+    uint32 priority;
+    uint32 uid;
+    uint32 cpu_ticks; //执行过的时间片
+    uint32 nvcsw; //主动让出的次数
+    uint32 nivcsw; //被抢占的次数
+    uint32 block_ticks; //阻塞的时间片
+    char name[16];
+} task_info_t;
+
 uint32 test();
 
 pid_t getpid();
@@ -64,6 +93,12 @@ pid_t getpid();
 uint32 brk(void *addr);
 void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset);
 int munmap(void *addr, size_t length);
+int msync(void *addr, size_t length, int flags);
+
+//把所有 dirty 缓冲写回磁盘
+int sync();
+//把文件所在设备的 dirty 缓冲写回磁盘
+int fsync(fd_t fd);
 
 
 //打开文件
@@ -85,6 +120,11 @@ void exit(int status);
 
 pid_t waitpid(pid_t pid, int32 *status);
 
+//创建和当前进程共享地址空间的线程执行 fn(arg)，返回线程 id，用 waitpid 等待线程结束
+pid_t thread_create(void (*fn)(void *), void *arg);
+
+int futex(uint32 *addr, int op, uint32 val);
+
 time_t time();
 
 mode_t umask(mode_t mask);
@@ -138,6 +178,9 @@ int mkfs(char *devname, int icount);
 //执行程序
 int execve(char *filename, char *argv[], char *envp[]);
 
+//获取最多 count 个进程的信息，返回实际的数量
+int ps(task_info_t *info, int count);
+
 //复制文件描述符
 fd_t dup(fd_t oldfd);
 fd_t dup2(fd_t oldfd, fd_t newfd);
@@ -3,12 +3,15 @@
 #include "types.h"
 #include "stdlib.h"
 #include "list.h"
+#include "wait.h"
 
 #define KERNEL_USER 0
 #define NORMAL_USER 1000
 
 #define TASK_NAME_LEN 16
 #define TASK_FILE_NR 16//一个进程最多可以打开16个文件描述符表
+#define TASK_REGION_NR 16//一个进程最多的映射区域数量
+#define THREAD_STACK_SIZE 0x10000 //线程用户栈大小 64K，第一次访问时才分配
 
 typedef void *target_t;
 
@@ -25,14 +28,41 @@ typedef enum task_state_t {
 
 struct inode_t;
 struct file_t;
+struct task_info_t;
+
+//区域标记
+#define REGION_WRITE 0x1 //可写
+#define REGION_SHARED 0x2 //共享映射，写入的内容会写回文件
+
+//映射区域，缺页时才分配对应的页，文件区域从文件读取
+typedef struct vm_region_t {
+    uint32 start; //开始地址，页对齐，为 0 表示没有使用
+    uint32 end; //结束地址，页对齐
+    struct inode_t *inode; //映射的文件，NULL 表示匿名区域
+    uint32 offset; //start 对应的文件偏移
+    uint32 filesz; //文件中的字节数，之后到 end 的部分补 0
+    uint32 flags; //区域标记
+} vm_region_t;
+
 //进程控制块
 typedef struct task_t {
     uint32 *stack; //进程(线程)内核栈
     list_node_t node;//进程(线程)阻塞节点
+    list_node_t hnode;//pid 哈希表节点
+    list_node_t sibling;//父进程子进程链表节点
+    list_t children;//子进程链表
     task_state_t state; //进程(线程)状态
-    uint32 priority; //进程(线程)优先级
+    uint32 priority; //进程(线程)优先级，持有互斥量时可能被等待者提升
+    uint32 base_priority; //进程(线程)本来的优先级
+    list_t locks; //持有的互斥量
+    struct mutex_t *blocked_on; //正在等待的互斥量
     uint32 ticks; //进程(线程)剩余时间片
     uint32 jiffies; //进程(线程)上次执行时的全局时间片
+    uint32 cpu_ticks; //进程(线程)执行过的时间片
+    uint32 nvcsw; //主动让出（阻塞、睡眠、等待）的次数
+    uint32 nivcsw; //时间片用完或者 yield 被切换的次数
+    uint32 block_ticks; //阻塞、睡眠和等待的总时间片
+    uint32 block_start; //最近一次阻塞时的全局时间片
     char name[TASK_NAME_LEN];//进程(线程)名
     uint32 uid; //进程用户id KERNERL_USER OR NORMAL_USER
     uint32 gid;//进程用户组id
@@ -52,6 +82,14 @@ typedef struct task_t {
     struct inode_t *iexec; //程序文件 inode
     uint16 umask; //进程用户权限
     struct file_t *files[TASK_FILE_NR];//进程文件描述符表项指针数组
+    vm_region_t regions[TASK_REGION_NR];//进程映射区域
+    struct task_t *group;//所在进程的主线程，地址空间、文件描述符表和当前目录都记录在主线程中，进程的 group 是自己
+    uint32 threads;//主线程记录进程中还没有退出的线程数量，包括自己
+    wait_queue_t thread_wait;//主线程退出时等待其它线程退出
+    uint32 ustack;//线程用户栈的最低地址，主线程为 0
+    uint32 futex;//futex 等待的用户地址
+    bool killed;//所在进程的主线程已经退出，线程返回用户态时退出
+    bool killable;//正在进程退出时可以被打断的睡眠中
     uint32 magic; //内核魔术，用于检测栈溢出
 } task_t;
 
@@ -99,10 +137,20 @@ typedef struct intr_frame_t
 
 task_t *running_task();
 
+task_t *running_group();//当前线程所在进程的主线程
+
+task_t *task_find(pid_t pid);//根据 pid 查找进程，不存在返回 NULL
+
+uint32 task_ready_count();//就绪队列中的进程数量，不包括 idle
+
 void schedule();
 
 void task_init();
 
+task_t *kernel_thread(target_t target, const char *name, uint32 priority);//创建一个就绪的内核线程，内核线程中创建的由创建者回收，其它的交给 idle
+
+void task_set_priority(task_t *task, uint32 priority);//修改当前生效的优先级，就绪的进程换到对应的就绪队列
+
 void task_to_user_mode();
 
 
@@ -111,22 +159,30 @@ void task_block(task_t *task, list_t *blist, task_state_t state);
 
 void task_unblock(task_t *task);
 
-void task_weakup();
-
 
 
 pid_t sys_getpid();//getpid系统调用处理函数
 
 pid_t sys_getppid();//getppid系统调用处理函数
 
+int sys_ps(struct task_info_t *info, int count);//ps系统调用处理函数
+
 void task_sleep(uint32 ms);//slepp系统调用处理函数
 
 void task_yield();//yield系统调用处理函数
 
 pid_t task_fork();//fork系统调用处理函数
 
+pid_t sys_clone(uint32 entry, uint32 arg1, uint32 arg2);//clone系统调用处理函数，创建共享地址空间的线程
+
+void futex_init();//初始化 futex 等待队列
+
+int sys_futex(uint32 *addr, int op, uint32 val);//futex系统调用处理函数
+
 void task_exit(int status);//exit系统调用处理函数
 
+void task_exit_check(intr_frame_t *frame);//中断返回之前调用，要回到用户态的线程如果所在进程已经退出，在这里退出
+
 pid_t task_waitpid(pid_t pid, int32 *status);
 
 fd_t task_get_fd(task_t *task);
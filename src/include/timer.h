@@ -0,0 +1,38 @@
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include "types.h"
+#include "list.h"
+
+struct timer_t;
+
+//定时器到期时在时钟中断中调用，此时中断是关闭的
+typedef void (*timer_handler_t)(struct timer_t *timer);
+
+//内核定时器，以时间片为单位
+typedef struct timer_t {
+    list_node_t node;//时间轮槽链表节点
+    uint32 expires;//到期的全局时间片
+    timer_handler_t handler;//到期处理函数
+    void *arg;//处理函数参数
+    bool active;//是否在时间轮中
+} timer_t;
+
+void timer_init();
+
+//初始化定时器
+void timer_setup(timer_t *timer, timer_handler_t handler, void *arg);
+
+//在全局时间片 expires 时调用定时器处理函数
+void timer_add(timer_t *timer, uint32 expires);
+
+//取消还没有到期的定时器
+void timer_del(timer_t *timer);
+
+//运行所有已经到期的定时器，由时钟中断调用
+void timer_run();
+
+//空闲时时钟最多可以停多少个时间片，不超过 count
+uint32 timer_idle(uint32 count);
+
+#endif
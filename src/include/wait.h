@@ -0,0 +1,17 @@
+#ifndef _WAIT_H_
+#define _WAIT_H_
+
+#include "types.h"
+#include "list.h"
+
+typedef struct wait_queue_t {
+    list_t waiters;//等待的进程，通过 task->node 串起来，新等待的在队首
+} wait_queue_t;//等待队列，可以有多个进程同时等待同一个事件
+
+void wait_queue_init(wait_queue_t *wq);//初始化等待队列
+void wait_sleep(wait_queue_t *wq);//阻塞当前进程直到被唤醒，调用时需要关闭中断
+bool wait_sleep_killable(wait_queue_t *wq);//同 wait_sleep，所在进程退出时也会被唤醒，这时返回 false
+bool wake_one(wait_queue_t *wq);//唤醒等待最久的进程，没有等待的进程返回 false
+void wake_all(wait_queue_t *wq);//唤醒所有等待的进程
+
+#endif
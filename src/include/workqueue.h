@@ -0,0 +1,13 @@
+#ifndef _WORKQUEUE_H_
+#define _WORKQUEUE_H_
+
+#include "types.h"
+
+typedef void (*work_func_t)(void *arg);
+
+void workqueue_init();
+
+//将 func(arg) 交给内核工作线程执行，可以在中断处理函数中调用，队列已满返回 false
+bool queue_work(work_func_t func, void *arg);
+
+#endif
@@ -4,39 +4,173 @@
 #include "../include/stdlib.h"
 #include "../include/debug.h"
 #include "../include/string.h"
+#include "../include/stdio.h"
+#include "../include/info.h"
+#include "../include/memstat.h"
 
-static arena_descriptor_t descriptors[DESC_COUNT];
+//前 DESC_COUNT 个描述符由 kmalloc 使用，其余的由 kmem_cache_create 分配
+static arena_descriptor_t descriptors[CACHE_NR];
+static uint32 cache_count;
+
+static void cache_setup(arena_descriptor_t *desc, char *name, uint32 block_size, kmem_ctor_t ctor) {
+    strncpy(desc->name, name, CACHE_NAMELEN);
+    desc->name[CACHE_NAMELEN - 1] = 0;
+    desc->block_size = block_size;
+    //每块另外用一个字节记录调用点，第一块按 4 字节对齐
+    desc->total_block = (PAGE_SIZE - sizeof(arena_t) - 3) / (block_size + 1);
+    desc->block_offset = (sizeof(arena_t) + desc->total_block + 3) & ~3;
+    desc->ctor = ctor;
+    desc->inuse = 0;
+    desc->arenas = 0;
+    list_init(&desc->free_list);
+}
+
+static int kmem_show(char *buf);
 
 //16byte ~ 1024byte(block_size)
 void arena_init() {
+    char name[CACHE_NAMELEN];
     uint32 block_size = 16;
     for (size_t i = 0; i < DESC_COUNT; ++i) {
-        arena_descriptor_t *desc = &descriptors[i];
-        desc->block_size = block_size;
-        desc->total_block = (PAGE_SIZE - sizeof(arena_t)) / block_size;
-        list_init(&desc->free_list);
+        sprintf(name, "kmalloc-%d", block_size);
+        cache_setup(&descriptors[i], name, block_size, NULL);
         block_size <<= 1;//block *= 2;
     }
+    cache_count = DESC_COUNT;
+    info_install("kmemstat", kmem_show);
 }
 
 //获得arena第idx块内存指针
 static void *get_arena_block(arena_t *arena, uint32 idx) {
     assert(arena->desc->total_block > idx);    
-    void *addr = (void *)(arena + 1);
+    void *addr = (void *)arena + arena->desc->block_offset;
     uint32 gap = idx * arena->desc->block_size;
     return addr + gap;
 }
 
-static arena_t *get_block_arena(list_node_t *block) {
+static arena_t *get_block_arena(void *block) {
     return (arena_t *)((uint32)block & 0xfffff000);
 }
+
+//块的分配调用点编号，保存在 arena 头之后
+static uint8 *get_block_site(void *block) {
+    arena_t *arena = get_block_arena(block);
+    uint32 idx = ((uint32)block - (uint32)arena - arena->desc->block_offset) / arena->desc->block_size;
+    return (uint8 *)(arena + 1) + idx;
+}
+
+//为描述符分配一页新的 arena，将所有块串到 arena 的空闲链表上
+static arena_t *arena_alloc(arena_descriptor_t *desc) {
+    arena_t *arena = (arena_t *)alloc_kpage(1);
+    memset(arena, 0, sizeof(arena_t));
+
+    arena->desc = desc;
+    arena->large = false;
+    arena->count = desc->total_block;
+    arena->magic = ONIX_MAGIC;
+    arena->free = NULL;
+    for (int i = arena->count - 1; i >= 0; --i) {
+        void **block = get_arena_block(arena, i);
+        *block = arena->free;
+        arena->free = block;
+    }
+    desc->arenas++;
+    list_insert_after(&desc->free_list.head, &arena->node);
+    return arena;
+}
+
+/******************************/
+/*         kmem_cache         */
+/******************************/
+kmem_cache_t *kmem_cache_create(char *name, size_t size, kmem_ctor_t ctor) {
+    //块中至少要能放下空闲链表指针，并保持 4 字节对齐
+    uint32 block_size = (size + 3) & ~3;
+    if (block_size < sizeof(void *)) {
+        block_size = sizeof(void *);
+    }
+    assert(block_size + 4 <= PAGE_SIZE - sizeof(arena_t));//还要放下一个字节的调用点编号和对齐
+    if (cache_count >= CACHE_NR) {
+        panic("no more kmem cache!!!");
+    }
+    kmem_cache_t *cache = &descriptors[cache_count++];
+    cache_setup(cache, name, block_size, ctor);
+    return cache;
+}
+
+static void *cache_alloc(kmem_cache_t *cache) {
+    arena_t *arena;
+    if (list_empty(&cache->free_list)) {
+        arena = arena_alloc(cache);
+    } else {
+        arena = element_entry(arena_t, node, cache->free_list.head.next);
+    }
+    assert(arena->large == false && arena->magic == ONIX_MAGIC);
+    assert(arena->count > 0 && arena->free);
+
+    void **block = arena->free;
+    arena->free = *block;
+    arena->count -= 1;
+    if (arena->count == 0) {//arena 已满，移出空闲链表
+        list_remove(&arena->node);
+    }
+    cache->inuse++;
+
+    if (cache->ctor) {
+        cache->ctor(block);
+    }
+    return block;
+}
+
+static void cache_free(kmem_cache_t *cache, void *ptr) {
+    assert(ptr);
+    arena_t *arena = get_block_arena(ptr);
+    assert(arena->magic == ONIX_MAGIC && arena->large == false);
+    assert(arena->desc == cache);
+    assert(cache->inuse > 0);
+
+    if (arena->count == 0) {//arena 重新有了空闲块
+        list_insert_after(&cache->free_list.head, &arena->node);
+    }
+    void **block = ptr;
+    *block = arena->free;
+    arena->free = block;
+    arena->count++;
+    cache->inuse--;
+
+    if (arena->count == cache->total_block) {//整页都空闲，归还
+        list_remove(&arena->node);
+        arena->magic = 0;
+        cache->arenas--;
+        free_kpage((uint32)arena, 1);
+    }
+}
+
+//分配对象，并记录调用点
+static void *cache_alloc_track(kmem_cache_t *cache, uint32 caller) {
+    void *ptr = cache_alloc(cache);
+    *get_block_site(ptr) = memstat_alloc(MEMSTAT_KMALLOC, caller, 1);
+    return ptr;
+}
+
+static void cache_free_track(kmem_cache_t *cache, void *ptr) {
+    memstat_free(MEMSTAT_KMALLOC, *get_block_site(ptr), 1);
+    cache_free(cache, ptr);
+}
+
+void *kmem_cache_alloc(kmem_cache_t *cache) {
+    return cache_alloc_track(cache, (uint32)__builtin_return_address(0));
+}
+
+void kmem_cache_free(kmem_cache_t *cache, void *ptr) {
+    cache_free_track(cache, ptr);
+}
+
 /******************************/
 /*      kmalloc     kfree     */
 /******************************/
 void *kmalloc(size_t size) {
     arena_descriptor_t *desc = NULL;
     arena_t *arena;
-    list_node_t *block;
     char *addr;
     if (size > 1024) {
         uint32 asize = size + sizeof(arena_t);
@@ -48,6 +182,7 @@ void *kmalloc(size_t size) {
         arena->desc = NULL;
         arena->magic = ONIX_MAGIC;
         addr = (char *)((uint32)arena + sizeof(arena_t));
+        arena->site = memstat_alloc(MEMSTAT_KMALLOC, (uint32)__builtin_return_address(0), 1);
         return addr;
     }
 //如果size 在 16 byte ~ 1024byte之间，进行如下操作
@@ -58,49 +193,32 @@ void *kmalloc(size_t size) {
         }
     }
     assert(desc != NULL);
-    if (list_empty(&desc->free_list)) {
-        arena = (arena_t *)alloc_kpage(1);
-        memset(arena, 0, PAGE_SIZE);
-
-        arena->desc = desc;
-        arena->large = false;
-        arena->count = desc->total_block;
-        arena->magic = ONIX_MAGIC;
-
-        for (size_t i = 0; i < arena->count; ++i) {
-            block = get_arena_block(arena, i);
-            assert(!list_search(&arena->desc->free_list, block));
-            list_push(&arena->desc->free_list, block);
-            assert(list_search(&arena->desc->free_list, block));
-        }
-    }
-
-    block = list_pop(&desc->free_list);
-    arena = get_block_arena(block);
-    assert(arena->large == false && arena->magic == ONIX_MAGIC);
-    arena->count -= 1;
-    return block;
+    return cache_alloc_track(desc, (uint32)__builtin_return_address(0));
 }
 
 void kfree(void *ptr) {
     assert(ptr);
-    arena_t *arena = get_block_arena((list_node_t *)ptr);
+    arena_t *arena = get_block_arena(ptr);
     
     assert(arena->magic == ONIX_MAGIC);
 
     if (arena->large == true) {
+        memstat_free(MEMSTAT_KMALLOC, arena->site, 1);
         free_kpage((uint32)arena, arena->count);
     } else {
-        arena->count++;
-        list_push(&arena->desc->free_list, (list_node_t*)ptr);
-        if (arena->count == arena->desc->total_block) {
-            for (size_t i = 0; i < arena->desc->total_block; ++i) {
-                list_node_t *block = get_arena_block(arena, i);
-                assert(list_search(&arena->desc->free_list, block));
-                list_remove(block);
-                assert(!list_search(&arena->desc->free_list, block));
-            }
-            free_kpage((uint32)arena, 1);
-        }
+        cache_free_track(arena->desc, ptr);
+    }
+}
+
+//输出每个缓存的使用情况
+static int kmem_show(char *buf) {
+    char *ptr = buf;
+    ptr += sprintf(ptr, "name             size  inuse  total  pages\n");
+    for (size_t i = 0; i < cache_count; ++i) {
+        arena_descriptor_t *desc = &descriptors[i];
+        ptr += sprintf(ptr, "%-16s %4d  %5d  %5d  %5d\n",
+                       desc->name, desc->block_size, desc->inuse,
+                       desc->arenas * desc->total_block, desc->arenas);
     }
+    return ptr - buf;
 }
@@ -3,25 +3,56 @@
 #include "../include/debug.h"
 #include "../include/device.h"
 #include "../include/assert.h"
+#include "../include/info.h"
+#include "../include/stdio.h"
+#include "../include/clock.h"
+#include "../include/timer.h"
+#include "../include/workqueue.h"
+#include "../include/string.h"
+#include "../include/stdlib.h"
+#include "../include/interrupt.h"
 
-#define HASH_COUNT 31 //索引数 为素数 ? 有限域
+#define GOLDEN_RATIO 0x9E3779B9 //乘法散列的乘数，2^32 除以黄金分割比
+#define FLUSH_INTERVAL 1000 //后台写回的周期，毫秒
+#define DIRTY_AGE 3000 //dirty 块在缓存中停留超过这么久就写回，毫秒
+#define PREFETCH_PAGES 2 //预读时一次磁盘请求最多读入的页数
+#define PREFETCH_MAX (PREFETCH_PAGES * PAGE_SIZE / BLOCK_SIZE) //一次磁盘请求最多读入的块数
+#define PAGE_BUFFERS (PAGE_SIZE / BLOCK_SIZE) //一页数据可以放的缓冲数量
+#define BCACHE_SIZE 0x400000 //默认的缓存大小 4M，启动命令行 bcache= 可以修改
+#define KPAGE_RESERVE 128 //空闲内核页少于这么多时缓存不再增长
 
-static buffer_t *buffer_start = (buffer_t *)KERNEL_BUFFER_MEM;
-static uint32 buffer_count = 0;
+//缓冲描述符数组，按照缓存大小一次分配，
+//每 PAGE_BUFFERS 个描述符一组共用一页数据，数据页在需要时从内核页分配，收缩时整页释放
+static buffer_t *buffer_start;
+static buffer_t *buffer_ptr;//已经使用过的描述符之后的位置
+static uint32 buffer_max;//缓冲数量上限
+static uint32 buffer_count = 0;//有数据页的缓冲数量
+static list_t spare_list;//有数据页但是还没有使用过的缓冲
 
-//记录当前buffer_t 结构体位置
-static buffer_t *buffer_ptr = (buffer_t *)KERNEL_BUFFER_MEM;
+//没有进程引用的缓冲按最近释放的顺序排列，队首最近释放，从队尾淘汰，
+//被淘汰之前仍然在哈希表中并且有效，再次读取同一块时不用访问磁盘
+static list_t lru_list;
+static list_t wait_list; //等待进程链表
+static list_t *hash_table;//缓存哈希表，桶数是 2 的幂，按照缓冲数量确定
+static uint32 hash_bits;//桶数的位数
 
-//记录当前数据缓冲区的位置
-static void *buffer_data = (void *)(KERNEL_BUFFER_MEM + KERNEL_BUFFER_SIZE - BLOCK_SIZE);
+static uint32 hit_count;//bread 命中缓存的次数
+static uint32 miss_count;//bread 需要读磁盘的次数
+static uint32 evict_count;//淘汰有效缓冲的次数
+static uint32 flush_count;//写回 dirty 块的次数
+static uint32 prefetch_count;//预读的块数
+static uint32 request_count;//预读发出的磁盘请求数
+static uint32 shrink_count;//收缩释放的页数
 
-static list_t free_list; //缓存链表，被释放的块
-static list_t wait_list; //等待进程链表
-static list_t hash_table[HASH_COUNT];//缓存哈希表
+static timer_t flush_timer;//周期性地把写回交给工作线程
+static bool flushing;//工作线程正在写回
 
-//哈希函数
+static bool bflush_lru();
+
+//乘法散列，取乘积的高 hash_bits 位，相邻的块和不同设备上相同的块分散到不同的桶
 static uint32 hash(int32 dev, uint32 block) {
-    return (dev ^ block) % HASH_COUNT;
+    uint32 key = (block + (uint32)dev * GOLDEN_RATIO) * GOLDEN_RATIO;
+    return key >> (32 - hash_bits);
 }
 
 //根据设备号和块号从哈希表中获取buffer
@@ -42,68 +73,151 @@ static buffer_t *get_from_hash_table(int32 dev, uint32 block) {
 //将buffer放入哈希表
 static void hash_locate(buffer_t *bf) {
     uint32 idx = hash(bf->dev, bf->block);
-    list_t *list = &hash_table[idx];
-    assert(!list_search(list, &bf->hnode));
-    list_push(list, &bf->hnode);
+    list_insert_after(&hash_table[idx].head, &bf->hnode);
 }
 
-static buffer_t *get_new_buffer() {
-    buffer_t *bf = NULL;
-    if ((uint32)buffer_ptr + sizeof(buffer_t) < (uint32)buffer_data) {
-        bf = buffer_ptr;
-        bf->data = buffer_data;
+//分配一页数据给一组描述符，返回其中第一个缓冲，其余的放入 spare_list
+static buffer_t *get_new_page() {
+    //找一组没有数据页的描述符，前面的都有数据页时使用新的一组
+    buffer_t *group = buffer_start;
+    while (group < buffer_ptr && group->data) {
+        group += PAGE_BUFFERS;
+    }
+    if (group == buffer_ptr) {
+        assert(buffer_ptr + PAGE_BUFFERS <= buffer_start + buffer_max);
+        buffer_ptr += PAGE_BUFFERS;
+    }
+
+    char *data = (char *)alloc_kpage(1);
+    for (size_t i = 0; i < PAGE_BUFFERS; ++i) {
+        buffer_t *bf = group + i;
+        bf->data = data + i * BLOCK_SIZE;
         bf->dev = EOF;//设备号
         bf->block = 0;//对应设备的第几块
         bf->count = 0;
         bf->dirty = false;
         bf->valid = false;
-        reentrant_init(&bf->lock);
-        
-        buffer_count++;
-        buffer_ptr++;
-        buffer_data -= BLOCK_SIZE;
-        LOGK("buffer count %d\n", buffer_count);
+        bf->dirtied = 0;
+        bf->rnode.prev = NULL;
+        bf->rnode.next = NULL;
+        rwlock_init_name(&bf->lock, "buffer");
+        if (i) {
+            list_insert_after(&spare_list.head, &bf->rnode);
+        }
     }
-    return bf;
+    buffer_count += PAGE_BUFFERS;
+    LOGK("buffer count %d\n", buffer_count);
+    return group;
 }
 
-static buffer_t *get_free_buffer() {
-    buffer_t *bf = NULL;
-    while (true) {
-        bf = get_new_buffer();//如果内存还有空间，直接开辟一个新的buffer_t
-        if (bf) {
-            return bf;
+//取得一个没有使用过的缓冲，缓存没有达到目标大小并且内核页充足时分配新的数据页
+static buffer_t *get_new_buffer() {
+    if (!list_empty(&spare_list)) {
+        return element_entry(buffer_t, rnode, list_pop(&spare_list));
+    }
+    if (buffer_count + PAGE_BUFFERS > buffer_max || kpage_available() < KPAGE_RESERVE) {
+        return NULL;
+    }
+    return get_new_page();
+}
+
+uint32 buffer_shrink(uint32 count) {
+    bool intr = interrupt_disable();
+    uint32 freed = 0;
+    for (buffer_t *group = buffer_start; group < buffer_ptr && freed < count; group += PAGE_BUFFERS) {
+        if (!group->data) {
+            continue;
         }
-        //内存空间不够了,那么就只能看看free_list中是否有buffer_t了
-        if (!list_empty(&free_list)) {
-            bf = element_entry(buffer_t, rnode, list_popback(&free_list));
-            return bf;
+        //整页的缓冲都在 LRU 链表或者 spare_list 中，并且不是 dirty 才能释放
+        size_t i;
+        for (i = 0; i < PAGE_BUFFERS; ++i) {
+            buffer_t *bf = group + i;
+            if (bf->count || bf->dirty || !bf->rnode.next) {
+                break;
+            }
         }
-        //如果没有的话,就把自己阻塞在wait_list,等待某个缓冲释放
-        task_block(running_task(), &wait_list, TASK_BLOCKED);
+        if (i < PAGE_BUFFERS) {
+            continue;
+        }
+        char *data = group->data;
+        for (i = 0; i < PAGE_BUFFERS; ++i) {
+            buffer_t *bf = group + i;
+            list_remove(&bf->rnode);
+            if (bf->valid) {
+                list_remove(&bf->hnode);
+            }
+            bf->dev = EOF;
+            bf->valid = false;
+            bf->data = NULL;
+        }
+        free_kpage((uint32)data, 1);
+        buffer_count -= PAGE_BUFFERS;
+        shrink_count++;
+        freed++;
     }
+    set_interrupt_state(intr);
+    return freed;
 }
 
-//读取dev的block块
-buffer_t *bread(int32 dev, uint32 block) {
-    buffer_t *bf = get_from_hash_table(dev, block);//先从hash_table中找
-    //hash_table中找到了buffer
+//取得一个空闲的缓冲，内存还有空间就开辟新的，否则从 LRU 队尾开始淘汰干净的缓冲，没有时返回 NULL
+static buffer_t *get_free_buffer() {
+    buffer_t *bf = get_new_buffer();
     if (bf) {
-        reentrant_lock(&bf->lock);
-        assert(bf->valid == true);
-        if (bf->count == 0) {
-            reentrant_unlock(&bf->lock);
-            goto getagain;
-        }
-        bf->count++;
-        reentrant_unlock(&bf->lock);
         return bf;
     }
-getagain:
-    //hash_table中没有找到
-    bf = get_free_buffer();//获得一个新的buffer_t
+    list_node_t *node;
+    for (node = lru_list.tail.prev; node != &lru_list.head; node = node->prev) {
+        bf = element_entry(buffer_t, rnode, node);
+        if (!bf->dirty) {
+            break;
+        }
+    }
+    if (node == &lru_list.head) {
+        return NULL;
+    }
+    list_remove(node);
+    assert(bf->count == 0 && !bf->dirty);
+    if (bf->valid) {//从哈希表中删除被淘汰的块
+        list_remove(&bf->hnode);
+        evict_count++;
+    }
+    bf->dev = EOF;
+    bf->block = 0;
+    bf->valid = false;
+    return bf;
+}
+
+//读取dev的block块
+buffer_t *bread(int32 dev, uint32 block) {
+    buffer_t *bf = NULL;
+    while (true) {
+        bf = get_from_hash_table(dev, block);//先从hash_table中找
+        //hash_table中找到了buffer
+        if (bf) {
+            if (!bf->count) {//没有进程引用时在 LRU 链表中
+                list_remove(&bf->rnode);
+            }
+            bf->count++;//先增加引用，等待读入的时候不会被释放
+            hit_count++;
+            read_lock(&bf->lock);//其它进程正在读入这块时等待读入完成，已经有效时多个进程不用互相等待
+            assert(bf->valid == true);
+            read_unlock(&bf->lock);
+            return bf;
+        }
+        //hash_table中没有找到
+        bf = get_free_buffer();//获得一个新的buffer_t
+        if (bf) {
+            break;
+        }
+        //LRU 中都是 dirty 块时先把它们写回，否则等待某个缓冲释放，
+        //写回和等待期间别的进程可能已经读入了这块，重新查找
+        if (!bflush_lru()) {
+            task_block(running_task(), &wait_list, TASK_BLOCKED);
+        }
+    }
+    miss_count++;
     
-    reentrant_lock(&bf->lock);
+    write_lock(&bf->lock);
 
     assert(bf->count == 0 && bf->dirty == false && bf->valid == false);
     bf->count = 1;//该buffer的引用计数置为1
@@ -114,17 +228,80 @@ getagain:
     device_request(bf->dev, bf->data, BLOCK_SECS, bf->block * BLOCK_SECS, 0, REQ_READ);//对该设备请求读bf->block * BLOCK_SECS个扇区
     bf->valid = true;//将该buffer_t的valid置为true
     
-    reentrant_unlock(&bf->lock);
+    write_unlock(&bf->lock);
     
     return bf;
 }
 
+//把 [block, block + count) 中连续的 count 块一起读入已经加入哈希表的 bufs
+static void bprefetch_run(int32 dev, uint32 block, buffer_t **bufs, uint32 count, void *data) {
+    device_request(dev, data, count * BLOCK_SECS, block * BLOCK_SECS, 0, REQ_READ);
+    request_count++;
+    prefetch_count += count;
+    for (size_t i = 0; i < count; ++i) {
+        buffer_t *bf = bufs[i];
+        memcpy(bf->data, (char *)data + i * BLOCK_SIZE, BLOCK_SIZE);
+        bf->valid = true;
+        write_unlock(&bf->lock);
+        brelease(bf);
+    }
+}
+
+void bprefetch(int32 dev, uint32 block, uint32 count) {
+    buffer_t *bufs[PREFETCH_MAX];
+    void *data = NULL;//全部命中时不需要中转缓冲
+    uint32 start = block;
+    uint32 n = 0;
+    for (uint32 i = block; i < block + count; ++i) {
+        buffer_t *bf = get_from_hash_table(dev, i);
+        if (!bf) {
+            bf = get_free_buffer();//预读不等待空闲的缓冲
+        }
+        if (bf && !bf->valid && bf->dev == EOF) {//加入哈希表并持有写锁，读入之前 bread 在读锁上等待
+            write_lock(&bf->lock);
+            bf->count = 1;
+            bf->dev = dev;
+            bf->block = i;
+            hash_locate(bf);
+            if (!n) {
+                start = i;
+            }
+            bufs[n++] = bf;
+            if (n < PREFETCH_MAX && i + 1 < block + count) {
+                continue;
+            }
+        }
+        //已经在缓存中或者没有空闲缓冲，把之前连续的块一起读入
+        if (n) {
+            if (!data) {//要读入的缓冲已经持有引用，分配时收缩缓存不会淘汰它们
+                data = (void *)alloc_kpage(PREFETCH_PAGES);
+            }
+            bprefetch_run(dev, start, bufs, n, data);
+            n = 0;
+        }
+        if (!bf) {
+            break;
+        }
+    }
+    if (data) {
+        free_kpage((uint32)data, PREFETCH_PAGES);
+    }
+}
+
 //写缓冲
 void bwrite(buffer_t *bf) {
     assert(bf);
     device_request(bf->dev, bf->data, BLOCK_SECS, bf->block * BLOCK_SECS, 0, REQ_WRITE);//将该buffer_t写入对应设备的对应块
 }
 
+void bdirty(buffer_t *bf) {
+    assert(bf && bf->valid);
+    if (!bf->dirty) {
+        bf->dirty = true;
+        bf->dirtied = jiffies;
+    }
+}
+
 //释放缓冲
 void brelease(buffer_t *bf) {//释放某个buffer_t
     if (!bf) {
@@ -136,18 +313,9 @@ void brelease(buffer_t *bf) {//释放某个buffer_t
     if (bf->count) {//还有进程引用,直接返回
         return;
     }
-    
-    list_remove(&bf->hnode);//从hash_table中删除
-    
-    if (bf->dirty) {//如果该buffer_t为dirty块
-        bf->dirty = false;
-        bwrite(bf);//写入磁盘
-    }
-    bf->dev = EOF;
-    bf->block = 0;
-    bf->valid = false;
 
-    list_push(&free_list, &bf->rnode);//插入free_list
+    //保留在哈希表中，放到 LRU 队首，dirty 块由后台写回
+    list_insert_after(&lru_list.head, &bf->rnode);
 
     if (!list_empty(&wait_list)) {//如果有task阻塞,唤醒
         task_t *task = element_entry(task_t, node, list_pop(&wait_list));
@@ -155,16 +323,122 @@ void brelease(buffer_t *bf) {//释放某个buffer_t
     }
 }
 
+//写回一个 dirty 块，写回期间持有引用，不会被淘汰，写回时又被修改的话下次再写
+static void bflush(buffer_t *bf) {
+    if (!bf->count) {
+        list_remove(&bf->rnode);
+    }
+    bf->count++;
+    bf->dirty = false;
+    bwrite(bf);
+    flush_count++;
+    brelease(bf);
+}
+
+//写回 LRU 中所有的 dirty 块，返回是否写回了
+static bool bflush_lru() {
+    bool flushed = false;
+    list_node_t *node = lru_list.tail.prev;
+    while (node != &lru_list.head) {
+        buffer_t *bf = element_entry(buffer_t, rnode, node);
+        if (!bf->dirty) {
+            node = node->prev;
+            continue;
+        }
+        bflush(bf);//写回时会阻塞，链表可能变化，从队尾重新开始
+        flushed = true;
+        node = lru_list.tail.prev;
+    }
+    return flushed;
+}
+
+//写回设备 dev 上所有 dirty 块，dev 为 EOF 时写回所有设备；
+//只写回 aged 之前修改的块，aged 为 jiffies 时写回全部
+static void bflush_range(int32 dev, uint32 aged) {
+    for (buffer_t *bf = buffer_start; bf < buffer_ptr; ++bf) {
+        if (!bf->dirty || (dev != EOF && bf->dev != dev)) {
+            continue;
+        }
+        if ((int32)(aged - bf->dirtied) < 0) {
+            continue;
+        }
+        bflush(bf);
+    }
+}
+
+void bsync(int32 dev) {
+    bflush_range(dev, jiffies);
+}
+
+int sys_sync() {
+    bsync(EOF);
+    return 0;
+}
+
+//工作线程中写回存在时间超过 DIRTY_AGE 的块
+static void bflush_aged(void *arg) {
+    bflush_range(EOF, jiffies - DIRTY_AGE / jiffy);
+    flushing = false;
+}
+
+static void flush_timeout(timer_t *timer) {
+    if (!flushing && queue_work(bflush_aged, NULL)) {
+        flushing = true;
+    }
+    timer_add(timer, jiffies + FLUSH_INTERVAL / jiffy);
+}
+
+static int buffer_show(char *buf) {
+    uint32 total = hit_count + miss_count;
+    uint32 longest = 0;
+    for (size_t i = 0; i < (1u << hash_bits); ++i) {
+        longest = MAX(longest, list_size(&hash_table[i]));
+    }
+    char *ptr = buf;
+    ptr += sprintf(ptr, "buffers  %d of %d\n", buffer_count, buffer_max);
+    ptr += sprintf(ptr, "cached   %d\n", list_size(&lru_list));
+    ptr += sprintf(ptr, "hits     %d\n", hit_count);
+    ptr += sprintf(ptr, "misses   %d\n", miss_count);
+    ptr += sprintf(ptr, "evicts   %d\n", evict_count);
+    ptr += sprintf(ptr, "flushes  %d\n", flush_count);
+    ptr += sprintf(ptr, "prefetch %d blocks in %d requests\n", prefetch_count, request_count);
+    ptr += sprintf(ptr, "shrunk   %d pages\n", shrink_count);
+    ptr += sprintf(ptr, "hit rate %d%%\n", total ? hit_count * 100 / total : 0);
+    ptr += sprintf(ptr, "hash     %d buckets, longest chain %d\n", 1u << hash_bits, longest);
+    return ptr - buf;
+}
+
 void buffer_init() {
     LOGK("buffer_t size is %d\n", sizeof(buffer_t));
-    //初始化空闲链表
-    list_init(&free_list);
+    //初始化 LRU 链表
+    list_init(&lru_list);
     //初始化等待进程链表
     list_init(&wait_list);
 
-    //初始化哈希表
-    for (size_t i = 0; i < HASH_COUNT; ++i) {
+    list_init(&spare_list);
+
+    //缓存的目标大小，不超过现在空闲的内核页
+    uint32 pages = cmdline_size("bcache", BCACHE_SIZE) / PAGE_SIZE;
+    pages = MIN(pages, kpage_available() - KPAGE_RESERVE);
+    buffer_max = MAX(pages, 1) * PAGE_BUFFERS;
+    buffer_start = (buffer_t *)alloc_kpage(div_round_up(buffer_max * sizeof(buffer_t), PAGE_SIZE));
+    buffer_ptr = buffer_start;
+
+    //桶数取不小于缓冲数量一半的 2 的幂，平均每条链不超过两个缓冲
+    uint32 count = buffer_max;
+    hash_bits = 1;
+    while ((1u << hash_bits) < count / 2) {
+        hash_bits++;
+    }
+    uint32 buckets = 1u << hash_bits;
+    hash_table = (list_t *)alloc_kpage(div_round_up(buckets * sizeof(list_t), PAGE_SIZE));
+    for (size_t i = 0; i < buckets; ++i) {
         list_init(&hash_table[i]);
     }
+    LOGK("buffer hash %d buckets for %d buffers\n", buckets, count);
+    info_install("bufstat", buffer_show);
+
+    timer_setup(&flush_timer, flush_timeout, NULL);
+    timer_add(&flush_timer, jiffies + FLUSH_INTERVAL / jiffy);
 }
 
@@ -5,6 +5,7 @@
 #include "../include/interrupt.h"
 #include "../include/tasks.h"
 #include "../include/time.h"
+#include "../include/timer.h"
 
 #define PIT_CHAN0_REG 0x40
 #define PIT_CHAN1_REG 0x41
@@ -15,6 +16,7 @@
 #define OSCILLATOR 1193182
 #define CLOCK_COUNTER (OSCILLATOR / kHZ)
 #define JIFFY (1000 / kHZ)
+#define ONESHOT_MAX (0xffff / CLOCK_COUNTER) //单次模式一次最多可以停的时间片
 
 
 #define SPEAKER_REG 0X61
@@ -25,6 +27,7 @@ uint32 volatile jiffies = 0;
 uint32 jiffy = JIFFY;//一个时间片10ms
 
 static uint32 volatile beeping = 0;//初始为0，开始beep后，被设置为应该结束的那个时间片
+static uint32 oneshot = 0;//单次模式下这次时钟中断代表的时间片数量，0 表示周期模式
 
 void start_beep() {
     if (!beeping) {
@@ -40,16 +43,64 @@ static void stop_beep() {
     }
 }
 
+//计数器0 工作在周期模式，每个时间片中断一次
+static void pit_periodic() {
+    outb(PIT_CTRL_REG, 0b00110100);//选择通道0，先读/写计数器低字节，后读/写计数器高字节,方式2:比率发生器(分频)
+    outb(PIT_CHAN0_REG, CLOCK_COUNTER & 0xff);
+    outb(PIT_CHAN0_REG, (CLOCK_COUNTER >> 8) & 0xff);
+}
+
+void clock_idle_enter() {
+    assert(!get_interrupt_state());
+    if (oneshot || beeping || task_ready_count()) {//还有就绪的进程时不能停掉时钟
+        return;
+    }
+    uint32 count = timer_idle(ONESHOT_MAX);
+    if (count <= 1) {//下一个时间片就有定时器到期
+        return;
+    }
+    uint32 counter = CLOCK_COUNTER * count;
+    oneshot = count;
+    outb(PIT_CTRL_REG, 0b00110000);//选择通道0，方式0:计数结束时中断一次
+    outb(PIT_CHAN0_REG, counter & 0xff);
+    outb(PIT_CHAN0_REG, (counter >> 8) & 0xff);
+}
+
+void clock_idle_exit() {
+    assert(!get_interrupt_state());
+    if (!oneshot) {//单次中断已经到了
+        return;
+    }
+    outb(PIT_CTRL_REG, 0b00000000);//锁存通道0 的当前计数
+    uint32 left = inb(PIT_CHAN0_REG);
+    left |= inb(PIT_CHAN0_REG) << 8;
+
+    uint32 total = CLOCK_COUNTER * oneshot;
+    uint32 elapsed = left <= total ? (total - left) / CLOCK_COUNTER : oneshot;
+    oneshot = 0;
+    pit_periodic();
+    jiffies += elapsed;
+    running_task()->cpu_ticks += elapsed;
+    timer_run();
+}
+
 static void clock_handler(int vector) {
     assert(vector == 0x20);
     send_eoi(vector);
     stop_beep();//如果蜂鸣器的截至时间到了，就关闭它
-    task_weakup();//唤醒睡眠的任务
-    jiffies++;
+    uint32 elapsed = 1;
+    if (oneshot) {//空闲时停了 oneshot 个时间片，恢复周期模式
+        elapsed = oneshot;
+        oneshot = 0;
+        pit_periodic();
+    }
+    jiffies += elapsed;
+    timer_run();//运行到期的定时器，唤醒睡眠的任务
     //DEBUGK("clock jiffies %d ...\n", jiffies);
     task_t *task = running_task();
     assert(task->magic == ONIX_MAGIC);//确保PCB的信息没有被破坏
     task->jiffies = jiffies;
+    task->cpu_ticks += elapsed;
     task->ticks--;
     if (task->ticks == 0) {//时间片已经耗尽
         schedule();
@@ -63,9 +114,7 @@ time_t sys_time() {
 //8253芯片初始化
 static void pit_init() {
     //配置计数器0 时钟
-    outb(PIT_CTRL_REG, 0b00110100);//选择通道0，先读/写计数器低字节，后读/写计数器高字节,方式2:比率发生器(分频)
-    outb(PIT_CHAN0_REG, CLOCK_COUNTER & 0xff);
-    outb(PIT_CHAN0_REG, (CLOCK_COUNTER >> 8) & 0xff);
+    pit_periodic();
 
     //配置计数器2 蜂鸣器
     outb(PIT_CTRL_REG, 0b10110110);
@@ -74,6 +123,7 @@ static void pit_init() {
 }
 
 void clock_init() {
+    timer_init();
     pit_init();
     set_interrupt_handler(IRQ_CLOCK, clock_handler);
     set_interrupt_mask(IRQ_CLOCK, true);
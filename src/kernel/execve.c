@@ -208,6 +208,7 @@ static bool elf_validate(Elf32_Ehdr *ehdr) {
     return true;
 }
 
+//将段登记为文件映射区域，页在第一次访问时才从文件读入
 static void load_segment(inode_t *inode, Elf32_Phdr *phdr) {
     assert(phdr->p_align == 0x1000);      // 对齐到页
     assert((phdr->p_vaddr & 0xfff) == 0); // 对齐到页
@@ -215,24 +216,13 @@ static void load_segment(inode_t *inode, Elf32_Phdr *phdr) {
 
     // 需要页的数量
     uint32 count = div_round_up(MAX(phdr->p_memsz, phdr->p_filesz), PAGE_SIZE);
-    for (size_t i = 0; i < count; i++) {
-        uint32 addr = vaddr + i * PAGE_SIZE;
-        assert(addr >= USER_EXEC_ADDR && addr < USER_MMAP_ADDR);
-        link_page(addr);
-    }
-    inode_read(inode, (char *)vaddr, phdr->p_filesz, phdr->p_offset);
-    if (phdr->p_filesz < phdr->p_memsz) {//如果该段在内存占用大小大于文件占用大小，末尾补0
-        memset((char *)vaddr + phdr->p_filesz, 0, phdr->p_memsz - phdr->p_filesz);
-    }
-    // 如果段不可写，则置为只读
-    if ((phdr->p_flags & PF_W) == 0) {
-        for (size_t i = 0; i < count; i++) {//将该段对应的所有页都设置为readonly
-            uint32 addr = vaddr + i * PAGE_SIZE;
-            page_entry_t *entry = get_entry(addr, false);
-            entry->write = false;
-            entry->readonly = true;
-            flush_tlb(addr);
-        }
+    uint32 end = vaddr + count * PAGE_SIZE;
+    assert(vaddr >= USER_EXEC_ADDR && end <= USER_MMAP_ADDR);
+
+    // 如果段不可写，则该区域的页都是只读的
+    uint32 flags = (phdr->p_flags & PF_W) ? REGION_WRITE : 0;
+    if (!region_add(vaddr, end, inode, phdr->p_offset, phdr->p_filesz, flags)) {
+        panic("no more region!!!");
     }
 
     task_t *task = running_task();
@@ -241,31 +231,34 @@ static void load_segment(inode_t *inode, Elf32_Phdr *phdr) {
     } else if (phdr->p_flags == (PF_R | PF_W)) {
         task->data = vaddr;
     }
-    task->end = MAX(task->end, (vaddr + count * PAGE_SIZE));
+    task->end = MAX(task->end, end);
 }
 
 static uint32 load_elf(inode_t *inode) {
-    link_page(USER_EXEC_ADDR);
+    uint32 entry = EOF;
     int n = 0;
-    // 读取 ELF 文件头
-    n = inode_read(inode, (char *)USER_EXEC_ADDR, sizeof(Elf32_Ehdr), 0);
-    assert(n == sizeof(Elf32_Ehdr));
-    Elf32_Ehdr *ehdr = (Elf32_Ehdr *)USER_EXEC_ADDR;
-    if (!elf_validate(ehdr))
-        return EOF;
-    
+    // 读取 ELF 文件头和程序段头表到内核页中
+    Elf32_Ehdr *ehdr = (Elf32_Ehdr *)alloc_kpage(1);
+    n = inode_read(inode, (char *)ehdr, sizeof(Elf32_Ehdr), 0);
+    if (n != sizeof(Elf32_Ehdr) || !elf_validate(ehdr))
+        goto rollback;
+
+    if (sizeof(Elf32_Ehdr) + ehdr->e_phnum * ehdr->e_phentsize > PAGE_SIZE)
+        goto rollback;
+
     // 读取程序段头表
-    Elf32_Phdr *phdr = (Elf32_Phdr *)(USER_EXEC_ADDR + sizeof(Elf32_Ehdr));
+    Elf32_Phdr *phdr = (Elf32_Phdr *)(ehdr + 1);
     n = inode_read(inode, (char *)phdr, ehdr->e_phnum * ehdr->e_phentsize, ehdr->e_phoff);
 
-    Elf32_Phdr *ptr = phdr;
     for (size_t i = 0; i < ehdr->e_phnum; i++) {
-        if (ptr->p_type != PT_LOAD)
+        if (phdr[i].p_type != PT_LOAD)
             continue;
-        load_segment(inode, ptr);
-        ptr++;
+        load_segment(inode, &phdr[i]);
     }
-    return ehdr->e_entry;//返回程序入口地址
+    entry = ehdr->e_entry;//程序入口地址
+rollback:
+    free_kpage((uint32)ehdr, 1);
+    return entry;
 }
 
 //计算参数的数量
@@ -361,6 +354,11 @@ static uint32 copy_argv_envp(char *filename, char *argv[], char *envp[]) {
 }
 
 int sys_execve(char *filename, char *argv[], char *envp[]) {
+    //其它线程还在使用地址空间，不能替换进程映像
+    task_t *current = running_task();
+    if (current->group != current || current->threads > 1)
+        return EOF;
+
     inode_t *inode = namei(filename);
     int ret = EOF;
     if (!inode)
@@ -381,7 +379,9 @@ int sys_execve(char *filename, char *argv[], char *envp[]) {
      // 处理参数和环境变量
     uint32 top = copy_argv_envp(filename, argv, envp);
 
-    // 首先释放原程序的堆内存
+    // 首先释放原程序的文件映射区域和堆内存，fork 之后共享的页表整张丢弃
+    free_shared_pte();
+    region_free(task);
     task->end = USER_EXEC_ADDR;
     sys_brk((void *)USER_EXEC_ADDR);
 
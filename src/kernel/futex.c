@@ -0,0 +1,68 @@
+#include "../include/tasks.h"
+#include "../include/syscall.h"
+#include "../include/memory.h"
+#include "../include/wait.h"
+#include "../include/interrupt.h"
+#include "../include/assert.h"
+#include "../include/debug.h"
+
+//futex 只在同一个进程的线程之间使用，按用户地址散列到等待队列
+#define FUTEX_HASH_NR 32
+
+static wait_queue_t futex_queues[FUTEX_HASH_NR];
+
+void futex_init() {
+    for (size_t i = 0; i < FUTEX_HASH_NR; ++i) {
+        wait_queue_init(&futex_queues[i]);
+    }
+}
+
+static wait_queue_t *futex_queue(uint32 *addr) {
+    return &futex_queues[((uint32)addr >> 2) % FUTEX_HASH_NR];
+}
+
+//等待队列中同一个进程等待 addr 的线程，从等待最久的开始最多唤醒 count 个
+static int futex_wake(wait_queue_t *wq, uint32 *addr, uint32 count) {
+    task_t *group = running_group();
+    int woken = 0;
+    list_node_t *node = wq->waiters.tail.prev;
+    while (node != &wq->waiters.head && woken < count) {
+        list_node_t *prev = node->prev;
+        task_t *task = element_entry(task_t, node, node);
+        if (task->group == group && task->futex == (uint32)addr) {
+            task->futex = 0;
+            task_unblock(task);
+            woken++;
+        }
+        node = prev;
+    }
+    return woken;
+}
+
+int sys_futex(uint32 *addr, int op, uint32 val) {
+    if ((uint32)addr < USER_EXEC_ADDR || (uint32)addr >= USER_STACK_TOP || ((uint32)addr & 3)) {
+        return EOF;
+    }
+
+    assert(!get_interrupt_state());
+    wait_queue_t *wq = futex_queue(addr);
+    task_t *task = running_task();
+
+    switch (op) {
+    case FUTEX_WAIT:
+        //检查和睡眠之间中断是关闭的，不会丢失唤醒
+        if (*addr != val) {
+            return EOF;
+        }
+        task->futex = (uint32)addr;
+        if (!wait_sleep_killable(wq)) {//进程正在退出
+            task->futex = 0;
+            return EOF;
+        }
+        return 0;
+    case FUTEX_WAKE:
+        return futex_wake(wq, addr, val);
+    default:
+        return EOF;
+    }
+}
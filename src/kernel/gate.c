@@ -82,11 +82,17 @@ void syscall_init() {
     syscall_table[SYS_NR_MOUNT] = sys_mount;
     syscall_table[SYS_NR_UMOUNT] = sys_umount;
     syscall_table[SYS_NR_MKFS] = sys_mkfs;
+    syscall_table[SYS_NR_PS] = sys_ps;
     syscall_table[SYS_NR_MMAP] = sys_mmap;
     syscall_table[SYS_NR_MUNMAP] = sys_munmap;
+    syscall_table[SYS_NR_MSYNC] = sys_msync;
     syscall_table[SYS_NR_EXECVE] = sys_execve;
     syscall_table[SYS_NR_DUP] = sys_dup;
     syscall_table[SYS_NR_DUP2] = sys_dup2;
     syscall_table[SYS_NR_PIPE] = sys_pipe;
+    syscall_table[SYS_NR_CLONE] = sys_clone;
+    syscall_table[SYS_NR_FUTEX] = sys_futex;
+    syscall_table[SYS_NR_SYNC] = sys_sync;
+    syscall_table[SYS_NR_FSYNC] = sys_fsync;
 }
 
@@ -25,7 +25,13 @@ interrupt_entry:
     push eax
     call [handler_table + eax * 4];//调用对应的中断处理函数
 
+extern task_exit_check
 interrupt_exit:  
+    ;返回用户态之前，如果所在进程已经退出，线程在这里退出
+    push esp;中断帧的地址
+    call task_exit_check
+    add esp, 4
+
     add esp, 4;对应push eax, 调用结束恢复栈
 
     popad
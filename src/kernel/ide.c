@@ -110,10 +110,7 @@ static void ide_handler(int vector) {
     //读取常规状态寄存器，表示中断处理结束
     uint8 state = inb(ctrl->iobase + IDE_STATUS);
     LOGK("harddisk interrupt vectro %d state 0x%x\n", vector, state);
-    if (ctrl->waiter) {
-        task_unblock(ctrl->waiter);//唤醒该进程
-        ctrl->waiter = NULL;
-    }
+    wake_one(&ctrl->wait);//唤醒该进程
 }
 
 static uint32 ide_error(ide_ctrl_t *ctrl)
@@ -238,8 +235,7 @@ int ide_pio_read(ide_disk_t *disk, void *buf, uint8 count,uint32 lba)
     {
         task_t *task = running_task();
         if (task->state == TASK_RUNNING) {
-            ctrl->waiter = task;
-            task_block(task, NULL, TASK_BLOCKED);
+            wait_sleep(&ctrl->wait);
         }
         ide_busy_wait(ctrl, IDE_SR_DRQ);
         uint32 offset = ((uint32)buf + i * SECTOR_SIZE);
@@ -280,8 +276,7 @@ int ide_pio_write(ide_disk_t *disk, void *buf, uint8 count, uint32 lba)
         ide_pio_write_sector(disk, (uint16 *)offset);
         task_t *task = running_task();
         if (task->state == TASK_RUNNING) {//阻塞自己等磁盘写数据完成
-            ctrl->waiter = task;
-            task_block(task, NULL, TASK_BLOCKED);
+            wait_sleep(&ctrl->wait);
         }
         ide_busy_wait(ctrl, IDE_SR_NULL);
     }
@@ -400,9 +395,9 @@ static void ide_ctrl_init()
     {
         ide_ctrl_t *ctrl = &controllers[cidx];
         sprintf(ctrl->name, "ide%u", cidx);
-        reentrant_init(&ctrl->lock);
+        reentrant_init_name(&ctrl->lock, ctrl->name);
         ctrl->active = NULL;
-        ctrl->waiter = NULL;
+        wait_queue_init(&ctrl->wait);
         if (cidx) // 从通道
         {
             ctrl->iobase = IDE_IOBASE_SECONDARY;
@@ -0,0 +1,27 @@
+#include "../include/info.h"
+#include "../include/device.h"
+#include "../include/memory.h"
+#include "../include/string.h"
+#include "../include/assert.h"
+
+//每次读取都重新生成文本，再从 idx(文件偏移) 处拷贝 count 个字节
+static int info_read(info_show_t show, char *buf, size_t count, uint32 idx, int flags) {
+    char *page = (char *)alloc_kpage(1);
+    int len = show(page);
+    assert(len < PAGE_SIZE);
+
+    int ret = EOF;
+    if (idx < len) {
+        ret = len - idx;
+        if (ret > count) {
+            ret = count;
+        }
+        memcpy(buf, page + idx, ret);
+    }
+    free_kpage((uint32)page, 1);
+    return ret;
+}
+
+int32 info_install(char *name, info_show_t show) {
+    return device_install(DEV_CHAR, DEV_INFO, show, name, 0, NULL, info_read, NULL);
+}
@@ -3,6 +3,7 @@
 #include "../include/io.h"
 #include "../include/debug.h"
 #include "../include/mutex.h"
+#include "../include/wait.h"
 #include "../include/tasks.h"
 #include "../include/fifo.h"
 #include "../include/device.h"
@@ -223,7 +224,7 @@ static char keymap[][4] = {
 };
 
 static reentrantlock_t lock;//可重入锁
-static task_t *waiter;//等待输出的任务
+static wait_queue_t waiters;//等待输入的任务
 
 #define BUFFER_SIZE 64 //输入缓冲区的大小
 static char buf[BUFFER_SIZE];//输入缓冲区
@@ -339,10 +340,7 @@ static void keyboard_handler(int vector) {
     }
     // LOGK("keydown %c\n", ch);//输出
     fifo_put(&fifo, ch);//将字符放进循环队列缓冲区
-    if (waiter != NULL) {
-        task_unblock(waiter);//将它唤醒
-        waiter = NULL;
-    }
+    wake_one(&waiters);//唤醒等待输入的任务
 }
 
 static uint32 keyboard_read(void *dev, char* buf, uint32 count) {
@@ -350,13 +348,15 @@ static uint32 keyboard_read(void *dev, char* buf, uint32 count) {
     int nr = 0;
     while (nr < count) {
         while (fifo_empty(&fifo)) {
-            waiter = running_task();
-            task_block(waiter, NULL, TASK_BLOCKED);
+            if (!wait_sleep_killable(&waiters)) {//进程正在退出
+                goto rollback;
+            }
         }
         buf[nr++] = fifo_get(&fifo);
     }
+rollback:
     reentrant_unlock(&lock);//解锁
-    return count;
+    return nr;
 }
 
 void keyboard_init() {
@@ -366,7 +366,7 @@ void keyboard_init() {
     extcode_state = false;
     fifo_init(&fifo, buf, BUFFER_SIZE);
     reentrant_init(&lock);
-    waiter = NULL;
+    wait_queue_init(&waiters);
     set_interrupt_handler(IRQ_KEYBOARD, keyboard_handler);
     set_interrupt_mask(IRQ_KEYBOARD, true);//开启键盘中断信号，修改IMR寄存器
 
@@ -0,0 +1,68 @@
+#include "../include/lockstat.h"
+#include "../include/info.h"
+#include "../include/string.h"
+#include "../include/stdio.h"
+#include "../include/assert.h"
+
+#define LOCKSTAT_NR 32 //最多统计的锁名称数量
+
+static lock_stat_t stats[LOCKSTAT_NR];
+static uint32 stat_count;
+
+static int lockstat_show(char *buf);
+
+void lockstat_init() {
+    memset(stats, 0, sizeof(stats));
+    stat_count = 0;
+    info_install("lockstat", lockstat_show);
+}
+
+lock_stat_t *lockstat_get(char *name) {
+    for (size_t i = 0; i < stat_count; ++i) {
+        if (!strcmp(stats[i].name, name)) {
+            return &stats[i];
+        }
+    }
+    if (stat_count == LOCKSTAT_NR) {
+        return NULL;
+    }
+    lock_stat_t *stat = &stats[stat_count++];
+    strncpy(stat->name, name, LOCKSTAT_NAMELEN - 1);
+    return stat;
+}
+
+void lockstat_acquire(lock_stat_t *stat, bool contended, uint32 wait) {
+    stat->acquires++;
+    if (contended) {
+        stat->contends++;
+        stat->wait += wait;
+    }
+}
+
+void lockstat_release(lock_stat_t *stat, uint32 hold) {
+    if (hold > stat->hold_max) {
+        stat->hold_max = hold;
+    }
+}
+
+//按照等待次数从多到少输出
+static int lockstat_show(char *buf) {
+    lock_stat_t *order[LOCKSTAT_NR];
+    for (size_t i = 0; i < stat_count; ++i) {
+        size_t j = i;
+        while (j > 0 && order[j - 1]->contends < stats[i].contends) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = &stats[i];
+    }
+
+    char *ptr = buf;
+    ptr += sprintf(ptr, "name              acquires  contends      wait  holdmax\n");
+    for (size_t i = 0; i < stat_count; ++i) {
+        lock_stat_t *stat = order[i];
+        ptr += sprintf(ptr, "%-16s %9d %9d %9d %8d\n",
+                       stat->name, stat->acquires, stat->contends, stat->wait, stat->hold_max);
+    }
+    return ptr - buf;
+}
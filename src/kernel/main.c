@@ -21,8 +21,13 @@
 #include "../include/fs.h"
 #include "../include/ramdisk.h"
 #include "../include/serial.h"
+#include "../include/memstat.h"
+#include "../include/lockstat.h"
+#include "../include/workqueue.h"
 
 void kernel_init() {
+    memstat_init();//分配统计，之后的分配都会被记录
+    lockstat_init();//锁统计
     memory_map_init();//使用物理内存数组管理空闲页
     mapping_init();//开启分页机制
     arena_init();    
@@ -42,6 +47,7 @@ void kernel_init() {
     super_init();
     
     task_init();
+    workqueue_init();//工作线程
     set_interrupt_state(true);
     return;
 }
\ No newline at end of file
@@ -8,15 +8,17 @@
 #include "../include/syscall.h"
 #include "../include/fs.h"
 #include "../include/printk.h"
+#include "../include/memstat.h"
+#include "../include/buffer.h"
 
 //ards type
 #define ZONE_VALID 1 //ards可用内存区域
 #define ZONE_RESERVED 2 //ards 不可用区域
 
-#define IDX(addr) ((uint32)addr >> 12) //获取addr的页索引
-#define DIDX(addr) (((uint32)addr >> 22) & 0x3ff)//获取线性地址addr的页目录项索引
-#define TIDX(addr) (((uint32)addr >> 12) & 0x3ff)//获取线性地址addr的页表项索引
-#define PAGE(idx) ((uint32)idx << 12) //获取页索引idx对应的页的开始位置
+#define IDX(addr) ((uint32)(addr) >> 12) //获取addr的页索引
+#define DIDX(addr) (((uint32)(addr) >> 22) & 0x3ff)//获取线性地址addr的页目录项索引
+#define TIDX(addr) (((uint32)(addr) >> 12) & 0x3ff)//获取线性地址addr的页表项索引
+#define PAGE(idx) ((uint32)(idx) << 12) //获取页索引idx对应的页的开始位置
 #define ASSERT_PAGE(addr) assert((addr & 0xfff) == 0)
 
 
@@ -47,6 +49,12 @@ static uint32 free_pages = 0;//空闲内存页数
 
 #define used_pages (total_pages - free_pages) //已用页数
 
+#define CMDLINE_LEN 128
+static char cmdline[CMDLINE_LEN];//启动命令行，multiboot 信息之后可能被覆盖，先拷贝一份
+
+#define KPAGE_LOW 64 //空闲内核页少于这么多时先收缩磁盘缓存
+static uint32 kpage_free;//空闲内核页数
+
 void memory_init(uint32 magic, uint32 addr) {
     uint32 count;
     ards_t *ptr;
@@ -73,13 +81,19 @@ void memory_init(uint32 magic, uint32 addr) {
         multi_tag_t *tag = (multi_tag_t *)(addr + 8);
 
         LOGK("Announced mbi size 0x%x\n", size);
+        multi_tag_t *mmap = NULL;
         while (tag->type != MULTIBOOT_TAG_TYPE_END)
         {
             if (tag->type == MULTIBOOT_TAG_TYPE_MMAP)
-                break;
+                mmap = tag;
+            if (tag->type == MULTIBOOT_TAG_TYPE_CMDLINE)
+                strncpy(cmdline, ((multi_tag_string_t *)tag)->string, CMDLINE_LEN - 1);
             // 下一个 tag 对齐到了 8 字节
             tag = (multi_tag_t *)((uint32)tag + ((tag->size + 7) & ~7));
         }
+        assert(mmap);
+        tag = mmap;
+        LOGK("Command line %s\n", cmdline);
 
         multi_tag_mmap_t *mtag = (multi_tag_mmap_t *)tag;
         multi_mmap_entry_t *entry = mtag->entries;
@@ -126,13 +140,119 @@ static uint32 start_page = 0;//可分配物理内存起始位置
 static uint8 *memory_map;//物理内存数组
 static uint32 memory_map_pages;//物理内存数组占用的页数
 
+/******************************/
+/*      伙伴系统 buddy system    */
+/******************************/
+#define BUDDY_ORDER_NR 11 //伙伴系统的阶数，最大的块为 2^10 页 = 4M
+#define BUDDY_NONE 0xff //不是空闲块的首页
+
+static list_t free_area[BUDDY_ORDER_NR];//每一阶的空闲块链表
+static list_node_t *page_node;//每个物理页在空闲块链表中的结点，只有空闲块的首页使用
+static uint8 *page_order;//空闲块首页记录该块的阶，其他页为 BUDDY_NONE
+static uint32 buddy_start;//伙伴系统管理的起始页号，内核占用的 16M 之后
+static uint8 *page_site;//每个物理页的分配调用点编号，用于统计
+static uint16 *pte_count;//作为用户页表的物理页中有效页表项的数量
+static uint8 kpage_site[IDX(KERNEL_MEMORY_SIZE)];//每个内核页的分配调用点编号
+
+static void pcache_init();
+static bool pcache_reclaim();
+
+#define KMAP_NR 8 //临时映射槽数量
+static uint32 kmap_base;//第一个临时映射槽的虚拟地址
+
+//将以 idx 开始的 2^order 页放入空闲链表
+static void buddy_insert(uint32 idx, uint32 order) {
+    page_order[idx] = order;
+    //直接插入头结点后，避免 list_push 中 O(n) 的查找
+    list_insert_after(&free_area[order].head, &page_node[idx]);
+}
+
+//将以 idx 开始的空闲块从空闲链表中取出
+static void buddy_remove(uint32 idx) {
+    assert(page_order[idx] != BUDDY_NONE);
+    list_remove(&page_node[idx]);
+    page_order[idx] = BUDDY_NONE;
+}
+
+//释放以 idx 开始的 2^order 页，并与空闲的伙伴合并
+static void buddy_free(uint32 idx, uint32 order) {
+    while (order < BUDDY_ORDER_NR - 1) {
+        uint32 buddy = idx ^ (1 << order);//伙伴块的首页
+        if (buddy < buddy_start || buddy + (1 << order) > total_pages) {
+            break;
+        }
+        if (page_order[buddy] != order) {//伙伴不空闲，或者被拆分了
+            break;
+        }
+        buddy_remove(buddy);
+        idx = MIN(idx, buddy);
+        order++;
+    }
+    buddy_insert(idx, order);
+}
+
+//分配 2^order 个连续的页，返回首页的页号
+static uint32 buddy_alloc(uint32 order) {
+    assert(order < BUDDY_ORDER_NR);
+    uint32 current = order;
+    while (current < BUDDY_ORDER_NR && list_empty(&free_area[current])) {
+        current++;
+    }
+    if (current == BUDDY_ORDER_NR) {
+        //释放只被页缓存引用的页后重试
+        if (pcache_reclaim()) {
+            return buddy_alloc(order);
+        }
+        panic("Out of Memory!!!");
+    }
+
+    list_node_t *node = free_area[current].head.next;
+    uint32 idx = node - page_node;
+    buddy_remove(idx);
+
+    //将多余的部分拆分，后一半放回低一阶的空闲链表
+    while (current > order) {
+        current--;
+        buddy_insert(idx + (1 << current), current);
+    }
+    return idx;
+}
+
+//将 [begin, end) 的物理页按照最大的对齐块放入伙伴系统
+static void buddy_init(uint32 begin, uint32 end) {
+    for (size_t i = 0; i < BUDDY_ORDER_NR; ++i) {
+        list_init(&free_area[i]);
+    }
+    buddy_start = begin;
+    uint32 idx = begin;
+    while (idx < end) {
+        uint32 order = BUDDY_ORDER_NR - 1;
+        while ((idx & ((1 << order) - 1)) || idx + (1 << order) > end) {
+            order--;
+        }
+        buddy_insert(idx, order);
+        idx += 1 << order;
+    }
+}
+
 void memory_map_init() {
     memory_map = (uint8 *)memory_base;//初始化物理内存数组
-    memory_map_pages = div_round_up(total_pages, PAGE_SIZE);
+    //物理内存数组之后依次存放伙伴系统的结点数组、阶数组和调用点数组
+    uint32 node_offset = (total_pages + 3) & ~3;
+    uint32 order_offset = node_offset + total_pages * sizeof(list_node_t);
+    uint32 site_offset = order_offset + total_pages;
+    uint32 count_offset = (site_offset + total_pages + 1) & ~1;
+    page_node = (list_node_t *)(memory_map + node_offset);
+    page_order = memory_map + order_offset;
+    page_site = memory_map + site_offset;
+    pte_count = (uint16 *)(memory_map + count_offset);
+
+    memory_map_pages = div_round_up(count_offset + total_pages * sizeof(uint16), PAGE_SIZE);
     LOGK("Memory map page count %d\n", memory_map_pages);
     free_pages -= memory_map_pages;
     //清空物理内存数组
     memset(memory_map, 0, memory_map_pages * PAGE_SIZE);
+    memset(page_order, BUDDY_NONE, total_pages);
 
     //前1M的页已经被占用，物理内存数组使用的页也已经被占用
     start_page = IDX(MEMORY_BASE) + memory_map_pages;
@@ -140,23 +260,52 @@ void memory_map_init() {
         memory_map[i] = 1;//物理内存数组置为1,表示该页被占用
     }
     LOGK("Total pages %d free pages %d", total_pages, free_pages);
+    //内核占用的 16M 在 mapping_init 中被全部占用，之后的页交给伙伴系统管理
+    buddy_init(IDX(KERNEL_MEMORY_SIZE), total_pages);
+
     uint32 length = (IDX(KERNEL_MEMORY_SIZE) - IDX(MEMORY_BASE)) / 8;
     bitmap_init(&kernel_map, (uint8 *)KERNEL_MAP_BITS, length, IDX(MEMORY_BASE));//map->offset设置为可分配的起始页号
-    bitmap_scan(&kernel_map, memory_map_pages);//memory_map数组使用的两个页已经不能用于分配了，在位图中将其对应位置1
+    bitmap_scan(&kernel_map, memory_map_pages);//memory_map数组使用的页已经不能用于分配了，在位图中将其对应位置1
+    //保留一段内核虚拟页作为临时映射槽，页表项会被改为指向任意物理页
+    kmap_base = PAGE(bitmap_scan(&kernel_map, KMAP_NR));
+    //内存虚拟磁盘直接使用固定的内存
+    for (size_t i = IDX(KERNEL_RAMDISK_MEM); i < IDX(KERNEL_RAMDISK_MEM + KERNEL_RAMDISK_SIZE); ++i) {
+        bitmap_set(&kernel_map, i, true);
+    }
+    //空闲内核页数从位图中统计，和上面的保留保持一致
+    kpage_free = 0;
+    for (size_t i = kernel_map.offset; i < kernel_map.offset + length * 8; ++i) {
+        kpage_free += !bitmap_test(&kernel_map, i);
+    }
+
+    pcache_init();
 }
 
-static uint32 get_page() {
-    for (size_t i = start_page; i < total_pages; ++i) {
-        if (!memory_map[i]) {//该页没有被占用
-            memory_map[i] = 1;
-            --free_pages;
-            assert(free_pages >= 0)
-            uint32 page = PAGE(i);
-            LOGK("GET page 0x%p\n", page);
-            return page;
-        }
+//分配 2^order 个连续的物理页，记在调用点 caller 名下
+static uint32 alloc_pages(uint32 order, uint32 caller) {
+    uint32 idx = buddy_alloc(order);
+    uint32 count = 1 << order;
+    uint8 site = memstat_alloc(MEMSTAT_PAGE, caller, count);
+    for (size_t i = 0; i < count; ++i) {
+        assert(memory_map[idx + i] == 0);
+        memory_map[idx + i] = 1;
+        page_site[idx + i] = site;
     }
-    panic("Out of Memory!!!");
+    free_pages -= count;
+    assert(free_pages >= 0);
+    uint32 page = PAGE(idx);
+    LOGK("GET pages 0x%p order %d\n", page, order);
+    return page;
+}
+
+//分配 2^order 个连续的物理页，返回物理地址
+uint32 get_pages(uint32 order) {
+    return alloc_pages(order, (uint32)__builtin_return_address(0));
+}
+
+//分配一个物理页，记在调用点 caller 名下，内部的辅助函数传入自己的调用者
+static uint32 get_page(uint32 caller) {
+    return alloc_pages(0, caller);
 }
 
 static void put_page(uint32 addr) {//addr为物理地址
@@ -169,12 +318,23 @@ static void put_page(uint32 addr) {//addr为物理地址
 
     memory_map[idx]--;//物理引用计数减1
 
-    if(!memory_map[idx]) {
+    if(!memory_map[idx]) {//没有引用了，归还给伙伴系统
         ++free_pages;
+        memstat_free(MEMSTAT_PAGE, page_site[idx], 1);
+        buddy_free(idx, 0);
     }
     assert(free_pages >= 0 && free_pages < total_pages);
     LOGK("PUT page 0x%p\n", addr);
 }
+
+//释放 2^order 个连续的物理页，每一页的引用计数分别减 1
+void put_pages(uint32 addr, uint32 order) {
+    uint32 count = 1 << order;
+    for (size_t i = 0; i < count; ++i) {
+        put_page(addr + i * PAGE_SIZE);
+    }
+}
+
 //得到cr2寄存器
 uint32 get_cr2() {
     asm volatile("movl %cr2, %eax\n");
@@ -193,10 +353,11 @@ void set_cr3(uint32 pde) {
 }
 
 //将cr0的最高位PG置为1,开启分页
+//同时置位 WP，内核写只读页也会触发缺页异常，写时复制对内核同样有效
 static _inline void enable_page() {//设置位内联函数
     asm volatile(
         "movl %cr0, %eax\n"
-        "orl $0x80000000, %eax\n"
+        "orl $0x80010000, %eax\n"
         "movl %eax, %cr0\n");
 }
 
@@ -243,6 +404,8 @@ static page_entry_t* get_pde() {//返回页目录的首地址（线性地址）
     return (page_entry_t *)(0xfffff000);
 }
 
+static void unshare_pte(uint32 didx);
+
 static page_entry_t* get_pte(uint32 vaddr, bool create) {//返回该线性地址对应的页表首地址(线性地址)
     page_entry_t *pde = get_pde();
     uint32 idx = DIDX(vaddr);//获取线性地址vaddr对应的页目录项索引
@@ -254,10 +417,13 @@ static page_entry_t* get_pte(uint32 vaddr, bool create) {//返回该线性地址
 
     if (!entry->present) {
         LOGK("Get and create page table entry for 0x%p\n", vaddr);
-        uint32 page = get_page();//获得一个未占用页的物理地址，这个地址还不能使用
+        uint32 page = get_page((uint32)get_pte);//获得一个未占用页的物理地址，这个地址还不能使用，页表都记在 get_pte 名下
         entry_init(entry, IDX(page));//只能用这个页的物理地址得到得页号 用来初始化页目录对应的页目录项
         // memset((void *)page, 0, PAGE_SIZE);bug，访问page又会触发page fault
         memset((void*)table, 0, PAGE_SIZE);
+        pte_count[IDX(page)] = 0;
+    } else if (!entry->write) {//fork 之后与其他进程共享的页表，修改之前先拷贝
+        unshare_pte(idx);
     }
     
     return table;
@@ -268,11 +434,84 @@ page_entry_t *get_entry(uint32 vaddr, bool create) {//返回线性地址vaddr对
     return &pte[TIDX(vaddr)];
 }
 
+//返回 vaddr 的页表项用于读取，页表不存在时返回 NULL
+//不拆分共享的页表，修改页表项之前需要再调用 get_entry
+static page_entry_t *find_entry(uint32 vaddr) {
+    page_entry_t *dentry = &get_pde()[DIDX(vaddr)];
+    if (!dentry->present) {
+        return NULL;
+    }
+    page_entry_t *table = (page_entry_t *)(PDE_MASK | (DIDX(vaddr) << 12));
+    return &table[TIDX(vaddr)];
+}
+
+//vaddr 所在页表的有效页表项数量
+static uint16 *pte_count_of(uint32 vaddr) {
+    page_entry_t *dentry = &get_pde()[DIDX(vaddr)];
+    assert(dentry->present);
+    return &pte_count[dentry->index];
+}
+
 //刷新虚拟地址 vaddr 的 快表 TLB
 void flush_tlb(uint32 vaddr) {
     asm volatile("invlpg (%0)" :: "r"(vaddr) : "memory");
 }
 
+//去掉 [start, end) 的物理内存映射，页表空了之后释放页表，最后只刷新一次快表
+//整张都在范围内的共享页表直接丢弃，不需要先拆分
+void unlink_range(uint32 start, uint32 end) {
+    ASSERT_PAGE(start);
+    ASSERT_PAGE(end);
+    page_entry_t *pde = get_pde();
+    bool flush = false;
+    uint32 vaddr = start;
+    while (vaddr < end) {
+        uint32 didx = DIDX(vaddr);
+        uint32 table_start = didx << 22;
+        uint32 table_end = table_start + (1 << 22);
+        uint32 stop = MIN(end, table_end);
+        if (stop < vaddr) {//最后一张页表，table_end 溢出
+            stop = end;
+        }
+        page_entry_t *dentry = &pde[didx];
+        if (!dentry->present) {
+            vaddr = stop;
+            continue;
+        }
+
+        if (vaddr == table_start && stop == table_end && !dentry->write && memory_map[dentry->index] > 1) {
+            put_page(PAGE(dentry->index));
+            dentry->present = false;
+            flush = true;
+            vaddr = stop;
+            continue;
+        }
+
+        for (; vaddr < stop; vaddr += PAGE_SIZE) {
+            page_entry_t *entry = find_entry(vaddr);
+            if (!entry->present) {
+                continue;
+            }
+            entry = get_entry(vaddr, false);//可能拆分共享的页表
+            entry->present = false;
+            put_page(PAGE(entry->index));
+            (*pte_count_of(vaddr))--;
+            flush = true;
+        }
+
+        dentry = &pde[didx];//页表可能已经被拆分
+        if (!pte_count[dentry->index]) {//页表中已经没有页了
+            LOGK("FREE page table 0x%p for 0x%p\n", PAGE(dentry->index), table_start);
+            put_page(PAGE(dentry->index));
+            dentry->present = false;
+            flush = true;
+        }
+    }
+    if (flush) {
+        set_cr3(running_task()->pde);
+    }
+}
+
 //将vaddr 映射物理内存
 void link_page(uint32 vaddr) {
     ASSERT_PAGE(vaddr);
@@ -284,8 +523,9 @@ void link_page(uint32 vaddr) {
         return;
     }
 
-    uint32 paddr = get_page();//paddr为物理地址
+    uint32 paddr = get_page((uint32)__builtin_return_address(0));//paddr为物理地址
     entry_init(entry, IDX(paddr));
+    (*pte_count_of(vaddr))++;
     flush_tlb(vaddr);
 
     LOGK("LINK from 0x%p to 0x%p\n", vaddr, paddr);
@@ -295,18 +535,14 @@ void link_page(uint32 vaddr) {
 void unlink_page(uint32 vaddr) {
     ASSERT_PAGE(vaddr);
 
-    page_entry_t *pde = get_pde();
-    page_entry_t *entry = &pde[DIDX(vaddr)];
-    if (!entry->present) {
-        return;
-    }
-    
-    entry = get_entry(vaddr, false);
-    if (!entry->present) {
+    page_entry_t *entry = find_entry(vaddr);
+    if (!entry || !entry->present) {
         return;
     }
 
+    entry = get_entry(vaddr, false);//可能拆分共享的页表
     entry->present = false;
+    (*pte_count_of(vaddr))--;
 
     uint32 paddr = PAGE(entry->index);
     DEBUGK("UNLINK FROM 0x%p to 0x%p", vaddr, paddr);
@@ -314,54 +550,515 @@ void unlink_page(uint32 vaddr) {
     flush_tlb(vaddr);
 }
 
-static uint32 copy_page(void *page) {
-    uint32 paddr = get_page();
-    uint32 vaddr = 0;
+/******************************/
+/*     临时映射 kmap            */
+/******************************/
+//将物理页 paddr 映射到临时映射槽 slot，返回槽的虚拟地址
+//不刷新快表，调用者映射完一批槽之后统一刷新
+static void *kmap_nflush(uint32 slot, uint32 paddr) {
+    assert(slot < KMAP_NR);
+    uint32 vaddr = kmap_base + slot * PAGE_SIZE;
+    //内核页表是恒等映射的，所有进程共用
+    page_entry_t *entry = (page_entry_t *)KERNEL_PAGE_TABLE[DIDX(vaddr)] + TIDX(vaddr);
+    entry_init(entry, IDX(paddr));
+    entry->user = 0;
+    return (void *)vaddr;
+}
 
-    page_entry_t *entry = get_pte(vaddr, false);
-    entry_init(entry, IDX(paddr));//现在虚拟地址0 -> paddr
-    flush_tlb(vaddr);//刷新虚拟地址0的映射
+static void *kmap(uint32 slot, uint32 paddr) {
+    void *vaddr = kmap_nflush(slot, paddr);
+    flush_tlb((uint32)vaddr);
+    return vaddr;
+}
 
-    memcpy((void *)0, (void *)page, PAGE_SIZE);
+//按 4 字节拷贝一页
+static _inline void copy_page_data(void *dst, void *src) {
+    uint32 ecx, edi, esi;
+    asm volatile(
+        "cld\n"
+        "rep movsl\n"
+        : "=&c"(ecx), "=&D"(edi), "=&S"(esi)
+        : "0"(PAGE_SIZE / 4), "1"(dst), "2"(src)
+        : "memory");
+}
 
-    entry->present = false;//重新让0号物理页没有被虚拟地址映射
-    flush_tlb(vaddr);//刷新虚拟地址0的映射
+//分配一个物理页，将虚拟地址 page 处的一页拷贝过去，返回物理地址
+static uint32 copy_page(void *page) {
+    uint32 paddr = get_page((uint32)__builtin_return_address(0));
+    void *vaddr = kmap(0, paddr);
+    copy_page_data(vaddr, page);
+    return paddr;
+}
 
-    return paddr;//返回新的页表的物理地址
+//拆分当前进程第 didx 个页目录项指向的共享页表
+//共享页表的页目录项是只读的，页表中的页只被页表引用一次
+static void unshare_pte(uint32 didx) {
+    page_entry_t *dentry = &get_pde()[didx];
+    assert(dentry->present && !dentry->write);
+    uint32 old = dentry->index;
+    assert(memory_map[old] > 0);
+
+    if (memory_map[old] > 1) {
+        uint32 paddr = get_page((uint32)get_pte);//拆分出来的页表也记在 get_pte 名下
+        //页目录项只读，不能通过递归映射写原页表，使用临时映射
+        page_entry_t *src = kmap(1, PAGE(old));
+        page_entry_t *dst = kmap(2, paddr);
+        for (size_t tidx = 0; tidx < 1024; ++tidx) {
+            page_entry_t *entry = &src[tidx];
+            if (!entry->present) {
+                continue;
+            }
+            //两张页表都引用了该页，不是共享页的改为写时复制
+            if (!entry->shared) {
+                entry->write = false;
+            }
+            memory_map[entry->index]++;
+            assert(memory_map[entry->index] < 255);
+        }
+        copy_page_data(dst, src);
+        pte_count[IDX(paddr)] = pte_count[old];
+        memory_map[old]--;
+        dentry->index = IDX(paddr);
+        LOGK("UNSHARE page table %d 0x%p -> 0x%p\n", didx, PAGE(old), paddr);
+    }
+    dentry->write = true;
+    set_cr3(running_task()->pde);//页目录项管理 4M 的地址，直接刷新整个快表
+}
+
+//释放当前进程还与其他进程共享的页表，用于 execve 丢弃整个用户地址空间
+//共享的页表 fork 之后没有被本进程修改过，其中的页由其他进程继续持有
+void free_shared_pte() {
+    page_entry_t *pde = get_pde();
+    for (size_t didx = (sizeof(KERNEL_PAGE_TABLE) / 4); didx < 1023; didx++) {
+        page_entry_t *dentry = &pde[didx];
+        if (!dentry->present || dentry->write || memory_map[dentry->index] == 1) {
+            continue;
+        }
+        put_page(PAGE(dentry->index));
+        dentry->present = false;
+    }
+    set_cr3(running_task()->pde);
 }
 
 page_entry_t *copy_pde() {
     task_t *task = running_task();
     page_entry_t *pde = (page_entry_t *)alloc_kpage(1);
-    memcpy(pde, (void *)task->pde, PAGE_SIZE);
+    copy_page_data(pde, (void *)task->pde);
     //将最后一个页目录项设置为页目录所在的页号
     page_entry_t *entry = &pde[1023];
     entry_init(entry, IDX(pde));
 
-    page_entry_t *dentry;
+    //用户页表不拷贝，父子进程共享，页目录项置为只读，第一次修改时再拷贝
+    page_entry_t *parent = get_pde();
     for (size_t didx = (sizeof(KERNEL_PAGE_TABLE) / 4); didx < 1023; didx++) {
-        dentry = &pde[didx];
+        page_entry_t *dentry = &pde[didx];
         if (!dentry->present) {
             continue;
         }
-        page_entry_t *pte = (page_entry_t *)(PDE_MASK | didx << 12);//bug
-        for (size_t tidx = 0; tidx < 1024; ++tidx) {
-            entry = &pte[tidx];
-            if (!entry->present) {
-                continue;
+        dentry->write = false;
+        parent[didx].write = false;
+        memory_map[dentry->index]++;//页表的引用计数加1
+        assert(memory_map[dentry->index] < 255);
+    }
+    set_cr3(task->pde);//刷新父进程的快表
+    return pde;
+}
+
+/******************************/
+/*      页缓存 page cache       */
+/******************************/
+#define PCACHE_NR 256 //最多缓存的文件页数量
+#define PCACHE_HASH_NR 61 //哈希桶数量
+#define PCACHE_SHARE_MAX 254 //缓存页的引用计数达到这个值后不再共享，留出 fork 拆分页表需要的余量
+
+//文件页缓存项，以 (dev, nr, 文件页号) 为键，持有物理页的一个引用
+typedef struct pcache_t {
+    int32 dev; //设备号，EOF 表示没有使用
+    uint32 nr; //inode 号
+    uint32 index; //文件中的页号
+    uint32 paddr; //物理页地址
+    list_node_t hnode; //哈希表结点
+    list_node_t rnode; //LRU 链表或者空闲链表结点
+} pcache_t;
+
+static pcache_t pcache_table[PCACHE_NR];
+static list_t pcache_hash[PCACHE_HASH_NR];
+static list_t pcache_lru; //使用中的缓存项，最近使用的在头部
+static list_t pcache_free; //空闲的缓存项
+
+static void pcache_init() {
+    list_init(&pcache_lru);
+    list_init(&pcache_free);
+    for (size_t i = 0; i < PCACHE_HASH_NR; ++i) {
+        list_init(&pcache_hash[i]);
+    }
+    for (size_t i = 0; i < PCACHE_NR; ++i) {
+        pcache_t *pc = &pcache_table[i];
+        pc->dev = EOF;
+        list_insert_after(&pcache_free.head, &pc->rnode);
+    }
+}
+
+static list_t *pcache_bucket(int32 dev, uint32 nr, uint32 index) {
+    return &pcache_hash[(dev * 31 + nr * 131 + index) % PCACHE_HASH_NR];
+}
+
+static pcache_t *pcache_find(int32 dev, uint32 nr, uint32 index) {
+    list_t *list = pcache_bucket(dev, nr, index);
+    for (list_node_t *node = list->head.next; node != &list->tail; node = node->next) {
+        pcache_t *pc = element_entry(pcache_t, hnode, node);
+        if (pc->dev == dev && pc->nr == nr && pc->index == index) {
+            //移到 LRU 头部
+            list_remove(&pc->rnode);
+            list_insert_after(&pcache_lru.head, &pc->rnode);
+            return pc;
+        }
+    }
+    return NULL;
+}
+
+//丢弃缓存项，释放它持有的物理页引用
+static void pcache_drop(pcache_t *pc) {
+    assert(pc->dev != EOF);
+    list_remove(&pc->hnode);
+    list_remove(&pc->rnode);
+    pc->dev = EOF;
+    list_insert_after(&pcache_free.head, &pc->rnode);
+    put_page(pc->paddr);
+}
+
+//将物理页 paddr 作为文件页加入缓存，返回是否加入
+//被进程映射的页不会被淘汰，共享映射直接写缓存中的页，淘汰后再映射的进程会读到另一份拷贝
+static bool pcache_insert(int32 dev, uint32 nr, uint32 index, uint32 paddr) {
+    if (list_empty(&pcache_free)) {
+        //淘汰最久没有使用、并且没有被进程映射的页
+        pcache_t *victim = NULL;
+        for (list_node_t *node = pcache_lru.tail.prev; node != &pcache_lru.head; node = node->prev) {
+            pcache_t *pc = element_entry(pcache_t, rnode, node);
+            if (memory_map[IDX(pc->paddr)] == 1) {
+                victim = pc;
+                break;
             }
-            assert(memory_map[entry->index] > 0);//该页表项指向的物理页已经被占用了
-            if (!entry->shared) {
-                entry->write = false;//如果过不是共享页，设置为只读
+        }
+        if (!victim) {//缓存的页都在使用中，新页不加入缓存
+            return false;
+        }
+        pcache_drop(victim);
+    }
+    pcache_t *pc = element_entry(pcache_t, rnode, list_pop(&pcache_free));
+    pc->dev = dev;
+    pc->nr = nr;
+    pc->index = index;
+    pc->paddr = paddr;
+    memory_map[IDX(paddr)]++;
+    list_insert_after(&pcache_bucket(dev, nr, index)->head, &pc->hnode);
+    list_insert_after(&pcache_lru.head, &pc->rnode);
+    return true;
+}
+
+//释放所有只被页缓存引用的页，返回是否释放了页
+static bool pcache_reclaim() {
+    bool reclaimed = false;
+    list_node_t *node = pcache_lru.tail.prev;
+    while (node != &pcache_lru.head) {
+        pcache_t *pc = element_entry(pcache_t, rnode, node);
+        node = node->prev;
+        if (memory_map[IDX(pc->paddr)] == 1) {
+            pcache_drop(pc);
+            reclaimed = true;
+        }
+    }
+    return reclaimed;
+}
+
+//文件内容 [start, end) 被修改，丢弃对应的缓存页，已经映射的进程保留原来的页
+void page_cache_invalidate(inode_t *inode, uint32 start, uint32 end) {
+    if (start >= end) {
+        return;
+    }
+    uint32 first = start / PAGE_SIZE;
+    uint32 last = (end - 1) / PAGE_SIZE;
+    //一次写入通常只涉及一两页，按页号查哈希表；截断整个文件等范围很大时直接扫描缓存表
+    if (last - first < PCACHE_NR) {
+        for (uint32 index = first; index <= last; ++index) {
+            pcache_t *pc = pcache_find(inode->dev, inode->nr, index);
+            if (pc) {
+                pcache_drop(pc);
             }
-            memory_map[entry->index]++;//该物理页的引用计数加1
-            assert(memory_map[entry->index] < 255);
         }
-        uint32 paddr = copy_page(pte);//拷贝一张页表
-        dentry->index = IDX(paddr);
+        return;
+    }
+    for (size_t i = 0; i < PCACHE_NR; ++i) {
+        pcache_t *pc = &pcache_table[i];
+        if (pc->dev == inode->dev && pc->nr == inode->nr && pc->index >= first && pc->index <= last) {
+            pcache_drop(pc);
+        }
     }
-    set_cr3(task->pde);
-    return pde;
+}
+
+static vm_region_t *region_find(task_t *task, uint32 vaddr);
+
+//将文件区域 region 中的页 vaddr 映射为文件的内容，超出文件末尾的部分补 0，返回是否映射了新页
+//整页都在文件中的页通过页缓存在进程间共享，写时复制
+static bool map_file_page(vm_region_t *region, uint32 vaddr) {
+    page_entry_t *entry;
+    inode_t *inode = region->inode;
+    uint32 skip = vaddr - region->start;
+    uint32 offset = region->offset + skip;
+    uint32 len = skip < region->filesz ? MIN(PAGE_SIZE, region->filesz - skip) : 0;
+    bool cacheable = len == PAGE_SIZE && (offset & 0xfff) == 0 &&
+                     offset + PAGE_SIZE <= inode->desc->size;
+    if (cacheable) {
+        pcache_t *pc = pcache_find(inode->dev, inode->nr, offset / PAGE_SIZE);
+        //引用计数只有 8 位，映射的进程太多时拷贝一份私有的页，不再加入缓存
+        if (pc && memory_map[IDX(pc->paddr)] >= PCACHE_SHARE_MAX) {
+            link_page(vaddr);
+            copy_page_data((void *)vaddr, kmap(0, pc->paddr));
+            LOGK("COPY cached page 0x%p for 0x%p\n", pc->paddr, vaddr);
+            return true;
+        }
+        if (pc) {
+            entry = get_entry(vaddr, true);
+            assert(!entry->present);
+            entry_init(entry, IDX(pc->paddr));
+            (*pte_count_of(vaddr))++;
+            entry->write = false;
+            memory_map[IDX(pc->paddr)]++;
+            flush_tlb(vaddr);
+            LOGK("SHARE cached page 0x%p for 0x%p\n", pc->paddr, vaddr);
+            return true;
+        }
+    }
+
+    //同一进程的线程共享页表，先读到内核页中，读完之后再安装页表项，其它线程不会看到读了一半的页
+    char *buf = (char *)alloc_kpage(1);
+    memset(buf, 0, PAGE_SIZE);
+    if (len) {//超出文件末尾的部分保持为 0
+        inode->count++;//读文件阻塞时区域可能被其它线程解除映射
+        inode_read(inode, buf, len, offset);
+        //程序和文件映射大多按顺序访问，预读后面的块
+        inode_readahead(inode, (offset + len) / BLOCK_SIZE, READAHEAD_BLOCKS);
+        iput(inode);
+    }
+    //阻塞期间区域可能被解除映射，或者其它线程已经处理了这一页的缺页
+    if (region_find(running_group(), vaddr) != region || region->inode != inode ||
+        region->offset + (vaddr - region->start) != offset) {
+        free_kpage((uint32)buf, 1);
+        return false;
+    }
+    entry = get_entry(vaddr, true);
+    if (entry->present) {
+        free_kpage((uint32)buf, 1);
+        return false;
+    }
+    uint32 paddr = get_page((uint32)__builtin_return_address(0));
+    copy_page_data(kmap(0, paddr), buf);
+    free_kpage((uint32)buf, 1);
+    entry_init(entry, IDX(paddr));
+    (*pte_count_of(vaddr))++;
+
+    //读文件可能阻塞，其他进程可能已经缓存了同一页，这时本页保持私有
+    if (cacheable && !pcache_find(inode->dev, inode->nr, offset / PAGE_SIZE) &&
+        pcache_insert(inode->dev, inode->nr, offset / PAGE_SIZE, paddr)) {
+        entry->write = false;//页缓存也引用了该页，写时复制
+    }
+    flush_tlb(vaddr);
+    return true;
+}
+
+/******************************/
+/*        文件映射区域          */
+/******************************/
+vm_region_t *region_add(uint32 start, uint32 end, inode_t *inode, uint32 offset, uint32 filesz, uint32 flags) {
+    ASSERT_PAGE(start);
+    ASSERT_PAGE(end);
+    task_t *task = running_group();
+    for (size_t i = 0; i < TASK_REGION_NR; ++i) {
+        vm_region_t *region = &task->regions[i];
+        if (region->start) {
+            continue;
+        }
+        region->start = start;
+        region->end = end;
+        region->inode = inode;
+        region->offset = offset;
+        region->filesz = filesz;
+        region->flags = flags;
+        if (inode) {
+            inode->count++;
+        }
+        return region;
+    }
+    return NULL;
+}
+
+void region_copy(task_t *task) {
+    for (size_t i = 0; i < TASK_REGION_NR; ++i) {
+        vm_region_t *region = &task->regions[i];
+        if (region->start && region->inode) {
+            region->inode->count++;
+        }
+    }
+}
+
+//将共享文件区域中 [start, end) 内的脏页写回文件
+static void region_sync(vm_region_t *region, uint32 start, uint32 end) {
+    inode_t *inode = region->inode;
+    if (!inode || !(region->flags & REGION_SHARED) || !(region->flags & REGION_WRITE)) {
+        return;
+    }
+    for (uint32 page = start; page < end; page += PAGE_SIZE) {
+        page_entry_t *entry = find_entry(page);
+        if (!entry || !entry->present || !entry->dirty) {
+            continue;
+        }
+        uint32 offset = region->offset + (page - region->start);
+        uint32 skip = page - region->start;
+        if (offset >= inode->desc->size || skip >= region->filesz) {//不扩展文件
+            continue;
+        }
+        uint32 len = MIN(PAGE_SIZE, MIN(inode->desc->size - offset, region->filesz - skip));
+        inode_write(inode, (char *)page, len, offset);
+        entry = get_entry(page, false);//清除脏位之前拆分共享的页表
+        entry->dirty = false;
+        flush_tlb(page);
+        //写回使页缓存失效，该页的内容就是文件的内容，重新放回缓存让其他进程继续共享
+        //写文件可能阻塞，同一页可能已经被其他进程的缺页重新缓存，不能重复加入
+        if (len == PAGE_SIZE && (offset & 0xfff) == 0 &&
+            !pcache_find(inode->dev, inode->nr, offset / PAGE_SIZE)) {
+            pcache_insert(inode->dev, inode->nr, offset / PAGE_SIZE, PAGE(entry->index));
+        }
+        LOGK("SYNC page 0x%p to offset 0x%p\n", page, offset);
+    }
+}
+
+//释放区域中 [start, end) 的页
+static void region_unlink(uint32 start, uint32 end) {
+    task_t *task = running_group();
+    unlink_range(start, end);
+    for (uint32 page = start; page < end; page += PAGE_SIZE) {
+        if (page >= USER_MMAP_ADDR && page < USER_STACK_BOTTOM && bitmap_test(task->vmap, IDX(page))) {
+            bitmap_set(task->vmap, IDX(page), false);
+        }
+    }
+}
+
+//解除当前进程 [start, end) 的区域映射，脏页先写回文件，区域被截断或者拆分
+static void region_unmap(uint32 start, uint32 end) {
+    task_t *task = running_group();
+    for (size_t i = 0; i < TASK_REGION_NR; ++i) {
+        vm_region_t *region = &task->regions[i];
+        if (!region->start || region->end <= start || end <= region->start) {
+            continue;
+        }
+        uint32 begin = MAX(start, region->start);
+        uint32 finish = MIN(end, region->end);
+        region_sync(region, begin, finish);
+
+        if (begin == region->start && finish == region->end) {//整个区域
+            iput(region->inode);
+            region->start = 0;
+            region->inode = NULL;
+            continue;
+        }
+        if (begin > region->start && finish < region->end) {//中间部分，拆分出后一半
+            uint32 skip = finish - region->start;
+            vm_region_t *tail = region_add(finish, region->end, region->inode,
+                                           region->offset + skip,
+                                           region->filesz > skip ? region->filesz - skip : 0,
+                                           region->flags);
+            if (!tail) {
+                panic("no more region!!!");
+            }
+            region->end = begin;
+            region->filesz = MIN(region->filesz, begin - region->start);
+            continue;
+        }
+        if (begin == region->start) {//截掉开头
+            uint32 skip = finish - region->start;
+            region->offset += skip;
+            region->filesz = region->filesz > skip ? region->filesz - skip : 0;
+            region->start = finish;
+        } else {//截掉结尾
+            region->end = begin;
+            region->filesz = MIN(region->filesz, begin - region->start);
+        }
+    }
+}
+
+void region_free(task_t *task) {
+    assert(task == running_task());
+    for (size_t i = 0; i < TASK_REGION_NR; ++i) {
+        vm_region_t *region = &task->regions[i];
+        if (!region->start) {
+            continue;
+        }
+        region_sync(region, region->start, region->end);
+        region_unlink(region->start, region->end);
+        iput(region->inode);
+        region->start = 0;
+        region->inode = NULL;
+    }
+}
+
+static vm_region_t *region_find(task_t *task, uint32 vaddr) {
+    for (size_t i = 0; i < TASK_REGION_NR; ++i) {
+        vm_region_t *region = &task->regions[i];
+        if (region->start && region->start <= vaddr && vaddr < region->end) {
+            return region;
+        }
+    }
+    return NULL;
+}
+
+//为区域中的页 page 分配物理页，文件区域从文件中读取内容，匿名区域清零
+static void region_fill(vm_region_t *region, uint32 page) {
+    uint32 offset = region->offset + (page - region->start);//页在文件中的偏移，读文件之后区域可能改变
+    if (region->inode) {
+        if (!map_file_page(region, page)) {//其它线程已经处理了这一页，或者区域已经被解除映射
+            return;
+        }
+    } else {
+        link_page(page);
+        memset((void *)page, 0, PAGE_SIZE);
+    }
+
+    page_entry_t *entry = get_entry(page, false);
+    entry->user = true;
+    entry->readonly = !(region->flags & REGION_WRITE);
+    if (region->flags & REGION_SHARED) {
+        //共享区域直接写页缓存中的页，通过脏位写回文件
+        entry->shared = true;
+        entry->write = !entry->readonly;
+    } else {
+        //私有区域和页缓存共享时写时复制
+        entry->private = true;
+        entry->write = !entry->readonly && memory_map[entry->index] == 1;
+    }
+    flush_tlb(page);
+    LOGK("FILL page 0x%p from offset 0x%p\n", page, offset);
+}
+
+bool memory_writable(void *addr, uint32 len) {
+    uint32 start = (uint32)addr;
+    if (start < USER_EXEC_ADDR || start >= USER_STACK_TOP || len > USER_STACK_TOP - start) {
+        return false;
+    }
+    task_t *task = running_group();
+    for (uint32 page = PAGE(IDX(start)); page < start + len; page += PAGE_SIZE) {
+        page_entry_t *entry = find_entry(page);
+        if (entry && entry->present) {
+            if (entry->readonly) {
+                return false;
+            }
+            continue;
+        }
+        vm_region_t *region = region_find(task, page);
+        if (region && !(region->flags & REGION_WRITE)) {//还没有读入的只读区域
+            return false;
+        }
+    }
+    return true;
 }
 
 typedef struct page_error_code_t
@@ -387,7 +1084,7 @@ void page_fault(uint32 vector, uint32 edi, uint32 esi, uint32 ebp, uint32 esp,
     LOGK("fault address 0x%p\n", vaddr);
 
     page_error_code_t *code = (page_error_code_t *)&error;
-    task_t *task = running_task();
+    task_t *task = running_group();
 
     // assert(KERNEL_MEMORY_SIZE <= vaddr && vaddr < USER_STACK_TOP);
     if (vaddr < USER_EXEC_ADDR || vaddr >= USER_STACK_TOP) {
@@ -397,12 +1094,19 @@ void page_fault(uint32 vector, uint32 edi, uint32 esi, uint32 ebp, uint32 esp,
     }
     if (code->present) {
         assert(code->write);//写操作造成的缺页异常
-        page_entry_t *entry = get_entry(vaddr, false); 
+        page_entry_t *entry = get_entry(vaddr, false);//共享的页表在这里被拆分
         
         assert(entry->present);//该页表项指向的物理页存在
+        if (entry->write) {//只是页目录项只读，页表拆分之后就可以写了
+            LOGK("WRITE page table for 0x%p\n", vaddr);
+            return;
+        }
+        if (entry->readonly) {//只读内存页不应该被写(程序员要求的)，用户程序的错误
+            printk("Segmentation Fault!!!\n");
+            task_exit(-1);
+        }
         assert(memory_map[entry->index] > 0);
         assert(!entry->shared);
-        assert(!entry->readonly);//只读内存页不应该被写(程序员要求的)
         assert(memory_map[entry->index] > 0)
         if (memory_map[entry->index] == 1) {//该物理页引用计数为1
             entry->write = true;
@@ -418,6 +1122,12 @@ void page_fault(uint32 vector, uint32 edi, uint32 esi, uint32 ebp, uint32 esp,
         return;
     }
 
+    vm_region_t *region = region_find(task, vaddr);
+    if (!code->present && region) {//文件映射区域，从文件读取该页
+        region_fill(region, PAGE(IDX(vaddr)));
+        return;
+    }
+
     if (!code->present && (vaddr < task->brk || vaddr >= USER_STACK_BOTTOM)) {//vaddr是在合理的堆地址或者栈地址，就进行内存映射
         uint32 page = PAGE(IDX(vaddr));
         link_page(page);
@@ -432,18 +1142,14 @@ uint32 sys_brk(void *addr) {
     uint32 brk = (uint32)addr;
     ASSERT_PAGE((uint32)addr);
 
-    task_t *task = running_task();
+    task_t *task = running_group();
     assert(task->uid != KERNEL_USER);
 
     assert(task->end <= brk && brk < USER_MMAP_ADDR);
 
     uint32 old_brk = task->brk;
     if (old_brk > brk) {
-        uint32 page = brk;
-        while (page < old_brk) {
-            unlink_page(page);
-            page += PAGE_SIZE;
-        }
+        unlink_range(brk, old_brk);
     } else if (IDX(brk - old_brk) > free_pages) {//内存不够用了
         return -1;
     }
@@ -476,10 +1182,22 @@ static void reset_page(bitmap_t *kernel_map, uint32 addr, uint32 count) {
     }
 }
 
-//分配count个连续的页
+//分配count个连续的页，内核页不够时先收缩磁盘缓存
 uint32 alloc_kpage(uint32 count) {
     assert(count > 0);
-    uint32 vaddr = scan_page(&kernel_map, count);
+    if (kpage_free < count + KPAGE_LOW) {
+        buffer_shrink(count + KPAGE_LOW - kpage_free);
+    }
+    int32 idx = bitmap_scan(&kernel_map, count);
+    while (idx == EOF && buffer_shrink(count)) {//空闲页不连续，继续收缩
+        idx = bitmap_scan(&kernel_map, count);
+    }
+    if (idx == EOF) {
+        panic("Scan page fail!!!");
+    }
+    kpage_free -= count;
+    uint32 vaddr = PAGE(idx);
+    kpage_site[IDX(vaddr)] = memstat_alloc(MEMSTAT_KPAGE, (uint32)__builtin_return_address(0), count);
     LOGK("ALLOC kernel pages 0x%p count %d", vaddr, count);
     return vaddr;
 }
@@ -488,10 +1206,40 @@ uint32 alloc_kpage(uint32 count) {
 void free_kpage(uint32 vaddr, uint32 count) {
     assert(count > 0);
     reset_page(&kernel_map, vaddr, count);
+    kpage_free += count;
+    memstat_free(MEMSTAT_KPAGE, kpage_site[IDX(vaddr)], count);
     LOGK("FREE kernel pages 0x%p count %d\n", vaddr, count);
 }
 
 
+uint32 kpage_available() {
+    return kpage_free;
+}
+
+uint32 cmdline_size(const char *name, uint32 size) {
+    size_t len = strlen(name);
+    for (char *ptr = cmdline; *ptr; ++ptr) {
+        if ((ptr != cmdline && ptr[-1] != ' ') || memcmp(ptr, name, len) || ptr[len] != '=') {
+            continue;
+        }
+        char *num = ptr + len + 1;
+        if (*num < '0' || *num > '9') {
+            break;
+        }
+        uint32 value = 0;
+        while (*num >= '0' && *num <= '9') {
+            value = value * 10 + *num++ - '0';
+        }
+        if (*num == 'K' || *num == 'k') {
+            value *= 1024;
+        } else if (*num == 'M' || *num == 'm') {
+            value *= 1024 * 1024;
+        }
+        return value;
+    }
+    return size;
+}
+
 void free_pde() {//释放当前进程的页目录
     task_t *task = running_task();
     assert(task->uid != KERNEL_USER);
@@ -504,6 +1252,12 @@ void free_pde() {//释放当前进程的页目录
             continue;
         }
 
+        //页表还被其他进程共享，只减少页表的引用
+        if (memory_map[dentry->index] > 1) {
+            put_page(PAGE(dentry->index));
+            continue;
+        }
+
         page_entry_t *pte = (page_entry_t *)(PDE_MASK | (didx << 12));
 
         for (size_t tidx = 0; tidx < 1024; tidx++) {
@@ -530,55 +1284,77 @@ void *sys_mmap(void *addr, size_t length, int prot, int flags, int fd, off_t off
     uint32 count = div_round_up(length, PAGE_SIZE);//需要映射的页的数量
     uint32 vaddr = (uint32)addr;//虚拟地址
 
-    task_t *task = running_task();
+    task_t *task = running_group();
+    inode_t *inode = NULL;
+    if (fd != EOF) {//需要将文件映射到页
+        if (fd >= TASK_FILE_NR || !task->files[fd]) {
+            return (void *)EOF;
+        }
+        inode = task->files[fd]->inode;
+        if (!ISFILE(inode->desc->mode)) {
+            return (void *)EOF;
+        }
+    }
+
     if (!vaddr) {
         vaddr = scan_page(task->vmap, count);
     }
-    assert(vaddr >= USER_MMAP_ADDR && vaddr < USER_STACK_BOTTOM);
+    assert(vaddr >= USER_MMAP_ADDR && vaddr + count * PAGE_SIZE <= USER_STACK_BOTTOM);
     for (size_t i = 0; i < count; ++i) {
-        uint32 page = vaddr + PAGE_SIZE * i;
-        link_page(page);//虚拟地址page --映射--> 物理地址？？？
-        bitmap_set(task->vmap, IDX(page), true);//该内存映射页已经被使用
-
-        page_entry_t *entry = get_entry(page, false);
-        entry->user = true;
-        entry->write = false;//映射的页默认不可写
-        entry->readonly = true;
-
-        if (prot & PROT_WRITE) {
-            entry->write = true;
-            entry->readonly = false;
-        }
-        if (flags & MAP_SHARED) {
-            entry->shared = true;
-        }
-        if (flags & MAP_PRIVATE) {
-            entry->private = true;
-        }
-
+        bitmap_set(task->vmap, IDX(vaddr + PAGE_SIZE * i), true);//该内存映射页已经被使用
     }
 
-    if (fd != EOF) {//需要将文件映射到页
-        lseek(fd, offset, SEEK_SET);
-        read(fd, (char *)vaddr, length);
+    uint32 rflags = 0;
+    if (prot & PROT_WRITE) {
+        rflags |= REGION_WRITE;
+    }
+    if (flags & MAP_SHARED) {
+        rflags |= REGION_SHARED;
+    }
+    //页在第一次访问时才分配，文件映射从文件读取
+    vm_region_t *region = region_add(vaddr, vaddr + count * PAGE_SIZE, inode, offset, inode ? length : 0, rflags);
+    if (!region) {
+        region_unlink(vaddr, vaddr + count * PAGE_SIZE);
+        return (void *)EOF;
+    }
+    //匿名共享映射需要在 fork 之前就存在，立即分配
+    if (!inode && (flags & MAP_SHARED)) {
+        for (size_t i = 0; i < count; ++i) {
+            region_fill(region, vaddr + PAGE_SIZE * i);
+        }
     }
     return (void *)vaddr;//映射的虚拟地址
 }
 
 int sys_munmap(void *addr, size_t length) {
-    task_t *task = running_task();
     uint32 vaddr = (uint32)addr;//内存映射虚拟地址
-    assert(vaddr >= USER_MMAP_ADDR && vaddr < USER_STACK_BOTTOM);
-
     ASSERT_PAGE(vaddr);
     uint32 count = div_round_up(length, PAGE_SIZE);
+    uint32 end = vaddr + count * PAGE_SIZE;
+    assert(vaddr >= USER_MMAP_ADDR && end <= USER_STACK_BOTTOM);
 
-    for (size_t i = 0; i < count; ++i) {
-        uint32 page = vaddr + PAGE_SIZE * i;
-        unlink_page(page);
-        assert(bitmap_test(task->vmap, IDX(page)));
-        bitmap_set(task->vmap, IDX(page), false);
-    }
+    region_unmap(vaddr, end);
+    region_unlink(vaddr, end);
+    return 0;
+}
 
+int sys_msync(void *addr, size_t length, int flags) {
+    uint32 vaddr = (uint32)addr;
+    if (vaddr & 0xfff) {
+        return EOF;
+    }
+    uint32 end = vaddr + div_round_up(length, PAGE_SIZE) * PAGE_SIZE;
+    task_t *task = running_group();
+    //脏页都写入缓冲，MS_SYNC 再把文件所在设备的缓冲写回磁盘
+    for (size_t i = 0; i < TASK_REGION_NR; ++i) {
+        vm_region_t *region = &task->regions[i];
+        if (!region->start || region->end <= vaddr || end <= region->start) {
+            continue;
+        }
+        region_sync(region, MAX(vaddr, region->start), MIN(end, region->end));
+        if ((flags & MS_SYNC) && region->inode) {
+            bsync(region->inode->dev);
+        }
+    }
     return 0;
 }
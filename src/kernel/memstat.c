@@ -0,0 +1,120 @@
+#include "../include/memstat.h"
+#include "../include/info.h"
+#include "../include/memory.h"
+#include "../include/string.h"
+#include "../include/stdio.h"
+#include "../include/assert.h"
+#include "../include/debug.h"
+
+#define SITE_NR 128 //最多记录的调用点数量，0 号表示未知调用点
+#define SITE_HASH_BITS 8
+#define SITE_HASH_NR (1 << SITE_HASH_BITS) //调用点散列表大小，大于 SITE_NR 保证总有空位
+
+//分配调用点，以返回地址区分
+typedef struct memstat_site_t {
+    uint32 caller; //调用者的返回地址，可以用 system.map 查到函数
+    uint32 type;   //分配类型
+    uint32 allocs; //分配次数
+    uint32 frees;  //释放次数
+    uint32 cur;    //当前持有的数量
+    uint32 peak;   //持有数量的最高值
+} memstat_site_t;
+
+static memstat_site_t sites[SITE_NR];
+static uint32 site_count;
+static uint8 site_hash[SITE_HASH_NR]; //(类型, 返回地址) -> 调用点编号，开放寻址，0 为空
+static uint32 type_cur[MEMSTAT_TYPE_NR]; //每种类型当前的总量
+static uint32 type_peak[MEMSTAT_TYPE_NR]; //每种类型总量的最高值
+
+static const char *type_names[] = {
+    "kmalloc",
+    "kpage",
+    "page",
+};
+
+static int memstat_show(char *buf);
+
+void memstat_init() {
+    memset(sites, 0, sizeof(sites));
+    memset(type_cur, 0, sizeof(type_cur));
+    memset(type_peak, 0, sizeof(type_peak));
+    memset(site_hash, 0, sizeof(site_hash));
+    site_count = 1;
+    info_install("memstat", memstat_show);
+}
+
+static _inline uint32 site_hash_index(memstat_type_t type, uint32 caller) {
+    return ((caller ^ type) * 2654435761u) >> (32 - SITE_HASH_BITS);
+}
+
+//查找调用点，不存在则新建
+static uint8 site_get(memstat_type_t type, uint32 caller) {
+    uint32 idx = site_hash_index(type, caller);
+    while (site_hash[idx]) {
+        memstat_site_t *site = &sites[site_hash[idx]];
+        if (site->caller == caller && site->type == type) {
+            return site_hash[idx];
+        }
+        idx = (idx + 1) & (SITE_HASH_NR - 1);
+    }
+    if (site_count == SITE_NR) {
+        return MEMSTAT_UNKNOWN;
+    }
+    memstat_site_t *site = &sites[site_count];
+    site->caller = caller;
+    site->type = type;
+    site_hash[idx] = site_count;
+    return site_count++;
+}
+
+uint8 memstat_alloc(memstat_type_t type, uint32 caller, uint32 count) {
+    uint8 idx = site_get(type, caller);
+    memstat_site_t *site = &sites[idx];
+    site->allocs++;
+    site->cur += count;
+    if (site->cur > site->peak) {
+        site->peak = site->cur;
+    }
+    type_cur[type] += count;
+    if (type_cur[type] > type_peak[type]) {
+        type_peak[type] = type_cur[type];
+    }
+    return idx;
+}
+
+void memstat_free(memstat_type_t type, uint8 idx, uint32 count) {
+    assert(idx < SITE_NR);
+    memstat_site_t *site = &sites[idx];
+    site->frees++;
+    //未知调用点混合了多种类型，不做检查
+    if (idx != MEMSTAT_UNKNOWN) {
+        assert(site->type == type && site->cur >= count);
+    }
+    site->cur -= count;
+    assert(type_cur[type] >= count);
+    type_cur[type] -= count;
+}
+
+//输出每种类型的总量以及每个调用点的统计，调用者地址可以用 system.map 查找
+static int memstat_show(char *buf) {
+    char *ptr = buf;
+    ptr += sprintf(ptr, "type        cur    peak\n");
+    for (size_t i = 0; i < MEMSTAT_TYPE_NR; ++i) {
+        ptr += sprintf(ptr, "%-8s %6d  %6d\n", type_names[i], type_cur[i], type_peak[i]);
+    }
+    ptr += sprintf(ptr, "\ncaller      type     allocs   frees    cur   peak\n");
+    for (size_t i = 0; i < site_count; ++i) {
+        memstat_site_t *site = &sites[i];
+        if (!site->allocs) {
+            continue;
+        }
+        if (ptr - buf > PAGE_SIZE - 64) {
+            ptr += sprintf(ptr, "...\n");
+            break;
+        }
+        ptr += sprintf(ptr, "0x%08x  %-8s %6d  %6d  %5d  %5d\n",
+                       site->caller, i ? type_names[site->type] : "unknown",
+                       site->allocs, site->frees, site->cur, site->peak);
+    }
+    return ptr - buf;
+}
@@ -1,41 +1,123 @@
 #include "../include/mutex.h"
 #include "../include/interrupt.h"
 #include "../include/assert.h"
+#include "../include/clock.h"
+#include "../include/stdlib.h"
 
 void mutex_init(mutex_t *mutex) {   // 初始化互斥量
     mutex->value = false;//没有被持有
-    list_init(&mutex->waiters);
+    wait_queue_init(&mutex->waiters);
+    mutex->holder = NULL;
+    mutex->node.prev = NULL;
+    mutex->node.next = NULL;
+    mutex->stat = NULL;
+    mutex->since = 0;
 }
+
+void mutex_init_name(mutex_t *mutex, char *name) {
+    mutex_init(mutex);
+    mutex->stat = lockstat_get(name);
+}
+
+#define INHERIT_DEPTH 8 //优先级沿着等待链传递的最大深度
+
+//优先级继承：持有者的优先级提升到 priority，如果持有者也在等待别的互斥量，继续提升那个互斥量的持有者
+static void mutex_inherit(mutex_t *mutex, uint32 priority) {
+    for (size_t i = 0; i < INHERIT_DEPTH && mutex; ++i) {
+        task_t *holder = mutex->holder;
+        if (!holder || holder->priority >= priority) {
+            break;
+        }
+        task_set_priority(holder, priority);
+        mutex = holder->blocked_on;
+    }
+}
+
+//释放互斥量之后，优先级恢复为本来的优先级和仍然持有的互斥量等待者中最高的优先级
+static void mutex_restore(task_t *task) {
+    uint32 priority = task->base_priority;
+    list_t *locks = &task->locks;
+    for (list_node_t *node = locks->head.next; node != &locks->tail; node = node->next) {
+        mutex_t *mutex = element_entry(mutex_t, node, node);
+        list_t *waiters = &mutex->waiters.waiters;
+        for (list_node_t *ptr = waiters->head.next; ptr != &waiters->tail; ptr = ptr->next) {
+            task_t *waiter = element_entry(task_t, node, ptr);
+            priority = MAX(priority, waiter->priority);
+        }
+    }
+    task_set_priority(task, priority);
+}
+
 void mutex_lock(mutex_t *mutex) {   // 尝试持有互斥量
     bool intr = interrupt_disable();
     
     task_t *current = running_task();
+    uint32 start = jiffies;
+    bool contended = mutex->value;
     while (mutex->value == true) {
-        task_block(current, &mutex->waiters, TASK_BLOCKED);
+        current->blocked_on = mutex;
+        mutex_inherit(mutex, current->priority);
+        wait_sleep(&mutex->waiters);
     }
+    current->blocked_on = NULL;
     assert(mutex->value == false);
     mutex->value++;
     assert(mutex->value == true);
+    mutex->holder = current;
+    list_insert_after(&current->locks.head, &mutex->node);
 
+    if (mutex->stat) {
+        lockstat_acquire(mutex->stat, contended, jiffies - start);
+        mutex->since = jiffies;
+    }
     set_interrupt_state(intr);
 }
 
-void mutex_unlock(mutex_t *mutex) { // 释放互斥量
-    bool intr = interrupt_disable();
-
+//释放互斥量，唤醒优先级最高的等待者，相同优先级唤醒等待最久的
+static bool mutex_release(mutex_t *mutex) {
+    if (mutex->stat) {
+        lockstat_release(mutex->stat, jiffies - mutex->since);
+    }
     assert(mutex->value == true);
+    assert(mutex->holder == running_task());
     mutex->value--;
     assert(mutex->value == false);
+    list_remove(&mutex->node);
+    mutex->holder = NULL;
+    mutex_restore(running_task());
+
+    list_t *waiters = &mutex->waiters.waiters;
+    task_t *task = NULL;
+    for (list_node_t *ptr = waiters->tail.prev; ptr != &waiters->head; ptr = ptr->prev) {
+        task_t *waiter = element_entry(task_t, node, ptr);
+        if (!task || waiter->priority > task->priority) {
+            task = waiter;
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    assert(task->magic == ONIX_MAGIC);
+    task_unblock(task);
+    return true;
+}
 
-    if (!list_empty(&mutex->waiters)) {
-        task_t *task = element_entry(task_t, node, mutex->waiters.tail.prev);//找到队尾的task
-        assert(task->magic == ONIX_MAGIC);
-        task_unblock(task);
+void mutex_unlock(mutex_t *mutex) { // 释放互斥量
+    bool intr = interrupt_disable();
+
+    if (mutex_release(mutex)) {
         task_yield();//确保让出自己的执行权，用于防止饥饿
     }
     set_interrupt_state(intr);
 }
 
+void mutex_unlock_noyield(mutex_t *mutex) {
+    bool intr = interrupt_disable();
+
+    mutex_release(mutex);
+    set_interrupt_state(intr);
+}
+
 
 void reentrant_init(reentrantlock_t *lock) {//可重入锁初始化
     lock->holder = NULL;
@@ -43,6 +125,11 @@ void reentrant_init(reentrantlock_t *lock) {//可重入锁初始化
     mutex_init(&lock->mutex);
 }
 
+void reentrant_init_name(reentrantlock_t *lock, char *name) {
+    reentrant_init(lock);
+    lock->mutex.stat = lockstat_get(name);
+}
+
 void reentrant_lock(reentrantlock_t *lock) {//加锁
     task_t *current = running_task();
     if (lock->holder != current) {
@@ -65,3 +152,137 @@ void reentrant_unlock(reentrantlock_t *lock) {//解锁
         mutex_unlock(&lock->mutex);
     }
 }
+
+
+void sema_init(semaphore_t *sema, int32 value) {
+    assert(value >= 0);
+    sema->value = value;
+    wait_queue_init(&sema->waiters);
+}
+
+void sema_down(semaphore_t *sema) {
+    bool intr = interrupt_disable();
+
+    while (sema->value <= 0) {
+        wait_sleep(&sema->waiters);
+    }
+    sema->value--;
+
+    set_interrupt_state(intr);
+}
+
+void sema_up(semaphore_t *sema) {
+    bool intr = interrupt_disable();
+
+    sema->value++;
+    wake_one(&sema->waiters);
+
+    set_interrupt_state(intr);
+}
+
+void cond_init(cond_t *cond) {
+    wait_queue_init(&cond->waiters);
+}
+
+void cond_wait(cond_t *cond, mutex_t *mutex) {
+    bool intr = interrupt_disable();//释放互斥量和阻塞之间不能被打断，否则会丢失唤醒
+
+    mutex_unlock_noyield(mutex);
+    wait_sleep(&cond->waiters);
+    mutex_lock(mutex);
+
+    set_interrupt_state(intr);
+}
+
+void cond_signal(cond_t *cond) {
+    bool intr = interrupt_disable();
+    wake_one(&cond->waiters);
+    set_interrupt_state(intr);
+}
+
+void cond_broadcast(cond_t *cond) {
+    bool intr = interrupt_disable();
+    wake_all(&cond->waiters);
+    set_interrupt_state(intr);
+}
+
+void rwlock_init(rwlock_t *lock) {
+    lock->readers = 0;
+    lock->writer = false;
+    wait_queue_init(&lock->rwaiters);
+    wait_queue_init(&lock->wwaiters);
+    lock->stat = NULL;
+    lock->since = 0;
+}
+
+void rwlock_init_name(rwlock_t *lock, char *name) {
+    rwlock_init(lock);
+    lock->stat = lockstat_get(name);
+}
+
+//锁空闲了，优先唤醒一个写者，没有写者等待时唤醒所有读者
+static void rwlock_wakeup(rwlock_t *lock) {
+    if (!wake_one(&lock->wwaiters)) {
+        wake_all(&lock->rwaiters);
+    }
+}
+
+void read_lock(rwlock_t *lock) {
+    bool intr = interrupt_disable();
+
+    uint32 start = jiffies;
+    bool contended = lock->writer || !list_empty(&lock->wwaiters.waiters);
+    while (lock->writer || !list_empty(&lock->wwaiters.waiters)) {//有写者等待时不再让新的读者进入，防止写者饥饿
+        wait_sleep(&lock->rwaiters);
+    }
+    lock->readers++;
+
+    if (lock->stat) {
+        lockstat_acquire(lock->stat, contended, jiffies - start);
+    }
+
+    set_interrupt_state(intr);
+}
+
+void read_unlock(rwlock_t *lock) {
+    bool intr = interrupt_disable();
+
+    assert(lock->readers > 0 && !lock->writer);
+    lock->readers--;
+    if (!lock->readers) {
+        rwlock_wakeup(lock);
+    }
+
+    set_interrupt_state(intr);
+}
+
+void write_lock(rwlock_t *lock) {
+    bool intr = interrupt_disable();
+
+    uint32 start = jiffies;
+    bool contended = lock->writer || lock->readers;
+    while (lock->writer || lock->readers) {
+        wait_sleep(&lock->wwaiters);
+    }
+    lock->writer = true;
+
+    if (lock->stat) {
+        lockstat_acquire(lock->stat, contended, jiffies - start);
+        lock->since = jiffies;
+    }
+
+    set_interrupt_state(intr);
+}
+
+void write_unlock(rwlock_t *lock) {
+    bool intr = interrupt_disable();
+
+    assert(lock->writer && !lock->readers);
+    if (lock->stat) {
+        lockstat_release(lock->stat, jiffies - lock->since);
+    }
+    lock->writer = false;
+    rwlock_wakeup(lock);
+
+    set_interrupt_state(intr);
+}
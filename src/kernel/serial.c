@@ -3,6 +3,7 @@
 #include "../include/fifo.h"
 #include "../include/tasks.h"
 #include "../include/mutex.h"
+#include "../include/wait.h"
 #include "../include/assert.h"
 #include "../include/device.h"
 #include "../include/debug.h"
@@ -42,10 +43,10 @@ typedef struct serial_t
     char rx_buf[BUF_LEN]; // 读 缓冲
 
     reentrantlock_t rlock;         // 读锁
-    task_t *rx_waiter;    // 读等待任务
+    wait_queue_t rx_wait; // 读等待队列
 
     reentrantlock_t wlock;         // 写锁
-    task_t *tx_waiter;    // 写等待任务
+    wait_queue_t tx_wait; // 写等待队列
 } serial_t;
 
 static serial_t serials[2];//两个串口字符设备
@@ -56,10 +57,7 @@ static void recv_data(serial_t *serial) {
         ch = '\n';
     }
     fifo_put(&serial->rx_fifo, ch);//将串口字符设备的字符放进fifo字符队列中
-    if (serial->rx_waiter != NULL) {//如果有等待的读进程，将其唤醒
-        task_unblock(serial->rx_waiter);
-        serial->rx_waiter = NULL;
-    }
+    wake_one(&serial->rx_wait);//如果有等待的读进程，将其唤醒
 }
 
 // 中断处理函数
@@ -76,9 +74,8 @@ static void serial_handler(int vector) {
     }
 
     // 如果可以发送数据，并且写进程阻塞
-    if ((state & LSR_THRE) && serial->tx_waiter) {
-        task_unblock(serial->tx_waiter);//将写进程唤醒
-        serial->tx_waiter = NULL;
+    if (state & LSR_THRE) {
+        wake_one(&serial->tx_wait);//将写进程唤醒
     }
 }
 
@@ -88,12 +85,13 @@ static int serial_read(serial_t *serial, char *buf, uint32 count) {
     while (nr < count) {
         while (fifo_empty(&serial->rx_fifo)) {
             //如果fifo读字符队列为空，将自己阻塞
-            assert(serial->rx_waiter == NULL);
-            serial->rx_waiter = running_task();
-            task_block(serial->rx_waiter, NULL, TASK_BLOCKED);
+            if (!wait_sleep_killable(&serial->rx_wait)) {//进程正在退出
+                goto rollback;
+            }
         }
         buf[nr++] = fifo_get(&serial->rx_fifo);
     }
+rollback:
     reentrant_unlock(&serial->rlock);
     return nr;
 }
@@ -108,9 +106,7 @@ static int serial_write(serial_t *serial, char *buf, uint32 count) {
             continue;
         }
         //阻塞自己
-        task_t *task = running_task();
-        serial->tx_waiter = task;
-        task_block(task, NULL, TASK_BLOCKED);
+        wait_sleep(&serial->tx_wait);
     }
     reentrant_unlock(&serial->wlock);
     return nr;
@@ -121,9 +117,9 @@ void serial_init() {
     for (size_t i = 0; i < 2; i++) {
         serial_t *serial = &serials[i];
         fifo_init(&serial->rx_fifo, serial->rx_buf, BUF_LEN);//初始化 读fifo队列
-        serial->rx_waiter = NULL;
+        wait_queue_init(&serial->rx_wait);
         reentrant_init(&serial->rlock);
-        serial->tx_waiter = NULL;
+        wait_queue_init(&serial->tx_wait);
         reentrant_init(&serial->wlock);
 
         uint16 irq;
@@ -2,7 +2,7 @@
 #include "../include/tasks.h"
 
 mode_t sys_umask(mode_t mask) {
-    task_t *task = running_task();
+    task_t *task = running_group();
     mode_t old = task->umask;
     task->umask = mask & 0777;
     return old;
@@ -14,42 +14,127 @@
 #include "../include/debug.h"
 #include "../include/fs.h"
 #include "../include/execve.h"
+#include "../include/info.h"
+#include "../include/timer.h"
+#include "../include/stdio.h"
 
 extern void task_switch(task_t *);
 extern file_t file_table[];
 
-#define NR_TASKS 64
-static task_t *task_table[NR_TASKS];//进程控制块PCB指针数组
+#define PID_MAX (PAGE_SIZE * 8) //pid 位图占一页
+#define PID_HASH_NR 64
+#define TASK_NR_MAX 256 //进程数量上限，受内核内存大小限制
+
+static bitmap_t pid_map;//已经使用的 pid
+static pid_t last_pid = -1;//上一次分配的 pid，从它之后开始分配，释放的 pid 不会马上被重用
+static list_t pid_hash[PID_HASH_NR];//pid 到进程控制块的哈希表
+static uint32 task_count;
 static list_t block_list; //进程默认阻塞链表
-static list_t sleep_list; //进程默认睡眠链表
-static task_t *idle_task;//指向task_table中一个idle_task
+static task_t *idle_task;//idle 进程，pid 为 0
+static kmem_cache_t *vmap_cache;//进程虚拟内存位图
 
-//在PCB数组中查找某种状态的PCB块
-static task_t* task_search(task_state_t state) {
-    task_t *task = NULL;
-    task_t *current = running_task();
+//就绪队列，每个优先级一个先进先出队列，通过 task->node 串起来
+#define PRIORITY_NR 32
+#define STARVE_JIFFIES 100 //就绪进程超过这么多时间片没有执行，就优先调度它
 
-    for (size_t i = 0; i < NR_TASKS; ++i) {
-        task_t *ptr = task_table[i];
-        if (ptr == NULL || ptr->state != state || ptr == current) {
-            continue;
-        }
-        if (task == NULL || task->ticks < ptr->ticks || task->jiffies > ptr->jiffies) {//task->jiffies的设置用于防止饥饿
+static list_t ready_list[PRIORITY_NR];
+static uint32 ready_bitmap;//非空就绪队列的位图
+static uint32 ready_count;//就绪进程数量，不包括 idle
+static uint32 switch_count;//进程切换次数
+static uint32 starve_count;//因为防止饥饿而提前调度的次数
+
+static uint32 ready_index(task_t *task) {
+    return task->priority < PRIORITY_NR ? task->priority : PRIORITY_NR - 1;
+}
+
+//将就绪的进程加入对应优先级队列的队尾，idle 不进入就绪队列
+static void ready_enqueue(task_t *task) {
+    assert(task->state == TASK_READY);
+    if (task == idle_task) {
+        return;
+    }
+    uint32 idx = ready_index(task);
+    list_insert_before(&ready_list[idx].tail, &task->node);
+    ready_bitmap |= 1u << idx;
+    ready_count++;
+}
+
+static void ready_dequeue(task_t *task) {
+    uint32 idx = ready_index(task);
+    list_remove(&task->node);
+    if (list_empty(&ready_list[idx])) {
+        ready_bitmap &= ~(1u << idx);
+    }
+    ready_count--;
+}
+
+//取出下一个要执行的进程：最高优先级队列的队首，
+//如果其它队列的队首等待太久，就先执行等待最久的那个，没有就绪进程时返回 idle
+static task_t *ready_pick() {
+    if (!ready_bitmap) {
+        return idle_task;
+    }
+    uint32 idx = 31 - __builtin_clz(ready_bitmap);
+    task_t *task = element_entry(task_t, node, ready_list[idx].head.next);
+
+    uint32 bits = ready_bitmap & ~(1u << idx);
+    while (bits) {
+        uint32 i = __builtin_ctz(bits);
+        bits &= bits - 1;
+        task_t *ptr = element_entry(task_t, node, ready_list[i].head.next);
+        if (jiffies - ptr->jiffies > STARVE_JIFFIES && ptr->jiffies < task->jiffies) {
             task = ptr;
         }
     }
-    if (task == NULL && state == TASK_READY) {//如果查找一遍PCB数组，不存在TASK_READY的进程，就准备调度idle进程
-        task = idle_task;//idle_task是作为备选的
+    if (ready_index(task) != idx) {
+        starve_count++;
     }
+    ready_dequeue(task);
     return task;
 }
 
+uint32 task_ready_count() {
+    return ready_count;
+}
+
+void task_set_priority(task_t *task, uint32 priority) {
+    assert(!get_interrupt_state());
+    if (task->priority == priority) {
+        return;
+    }
+    bool queued = task->state == TASK_READY && task != idle_task;
+    if (queued) {
+        ready_dequeue(task);
+    }
+    task->priority = priority;
+    if (queued) {
+        ready_enqueue(task);
+    }
+}
+
+static int sched_show(char *buf) {
+    char *ptr = buf;
+    ptr += sprintf(ptr, "switches %d\n", switch_count);
+    ptr += sprintf(ptr, "starved  %d\n", starve_count);
+    ptr += sprintf(ptr, "ready    %d\n", ready_count);
+    for (size_t i = PRIORITY_NR; i > 0; --i) {
+        if (ready_bitmap & (1u << (i - 1))) {
+            ptr += sprintf(ptr, "  prio %2d: %d\n", i - 1, list_size(&ready_list[i - 1]));
+        }
+    }
+    return ptr - buf;
+}
+
 task_t *running_task() {//返回当前运行PCB块指针
     asm volatile(
         "movl %esp, %eax\n"
         "andl $0xfffff000, %eax");
 }
 
+task_t *running_group() {
+    return running_task()->group;
+}
+
 void task_yield() {
     schedule();
 }
@@ -64,6 +149,7 @@ void task_block(task_t *task, list_t *blist, task_state_t state) {//将某个PCB
     list_push(blist, &task->node);
     assert(state != TASK_READY && state != TASK_RUNNING);
     task->state = state;
+    task->block_start = jiffies;
 
     task_t *current = running_task();
     if (current == task) {//阻塞的是自己
@@ -76,6 +162,18 @@ void task_unblock(task_t *task) {//将某个PCB块从block_list中删除，并
     list_remove(&task->node);
     assert(task->node.next == NULL && task->node.prev == NULL);
     task->state = TASK_READY;
+    task->block_ticks += jiffies - task->block_start;
+    ready_enqueue(task);
+}
+
+//睡眠时间到，重新加入就绪队列
+static void task_timeout(timer_t *timer) {
+    task_t *task = timer->arg;
+    assert(task->state == TASK_SLEEPING);
+    task->ticks = task->priority;
+    task->state = TASK_READY;
+    task->block_ticks += jiffies - task->block_start;
+    ready_enqueue(task);
 }
 
 void task_sleep(uint32 ms) {
@@ -83,43 +181,21 @@ void task_sleep(uint32 ms) {
 
     uint32 ticks = ms / jiffy;        // 需要睡眠的时间片
     ticks = ticks > 0 ? ticks : 1; // 至少休眠一个时间片
- 
-    // 记录目标全局时间片，在那个时刻需要唤醒任务
-    task_t *current = running_task();
-    current->ticks = jiffies + ticks;
 
-    // 从睡眠链表找到第一个比当前任务唤醒时间点更晚的任务，进行插入排序
-    //offset为task_t结构体类型中ticks成员和node成员的偏移
-    list_insert_sort(&sleep_list, &current->node, element_node_offset(task_t, node, ticks));
+    //定时器在睡眠期间一直有效，可以放在自己的内核栈上
+    task_t *current = running_task();
+    timer_t timer;
+    timer_setup(&timer, task_timeout, current);
+    timer_add(&timer, jiffies + ticks);
 
     // 阻塞状态是睡眠
     current->state = TASK_SLEEPING;
+    current->block_start = jiffies;
 
     // 调度执行其他任务
     schedule();
 }
 
-void task_weakup() {
-    assert(!get_interrupt_state()); // 已经关闭中断
-    // 从睡眠链表中找到 ticks 小于等于 jiffies 的任务，恢复执行
-    list_t *list = &sleep_list;
-    //将睡眠时间结束得进程唤醒
-    for (list_node_t *ptr = list->head.next; ptr != &list->tail;)
-    {
-        task_t *task = element_entry(task_t, node, ptr);
-        if (task->ticks > jiffies)
-        {
-            break;
-        }
-
-        // unblock 会将指针清空
-        ptr = ptr->next;
-
-        task->ticks = task->priority;
-        task_unblock(task);
-    }
-}
-
 static void task_activate(task_t *task) {
     assert(task->magic == ONIX_MAGIC);
     if (task->pde != get_cr3()) {//页目录需要更换
@@ -133,15 +209,23 @@ static void task_activate(task_t *task) {
 void schedule() {
     assert(!get_interrupt_state());//已经关闭了中断
     task_t *current = running_task();
-    task_t *next = task_search(TASK_READY);//找到一个处于就绪态的PCB块
-    assert(next != NULL);
-    assert(next->magic == ONIX_MAGIC);
     if (current->ticks == 0) {
         current->ticks = current->priority;
     }
 
-    if (current->state == TASK_RUNNING) {
+    //还在运行的进程先放回就绪队列再选择，只剩它可以执行时继续执行它，而不是切换到 idle
+    bool preempted = current->state == TASK_RUNNING;
+    if (preempted) {
         current->state = TASK_READY;
+        ready_enqueue(current);
+    }
+    task_t *next = ready_pick();//找到一个处于就绪态的PCB块
+    assert(next != NULL);
+    assert(next->magic == ONIX_MAGIC);
+    if (!preempted) {
+        current->nvcsw++;
+    } else if (next != current) {
+        current->nivcsw++;
     }
     if (next->state != TASK_READY) {
         if (next->state == TASK_SLEEPING) {
@@ -150,31 +234,67 @@ void schedule() {
         task_unblock(next);
     }
     next->state = TASK_RUNNING;
+    if (next != current) {
+        switch_count++;
+    }
     task_activate(next);
     task_switch(next);
 }
 
-static task_t *get_free_task() {
-    for (size_t i = 0; i < NR_TASKS; ++i) {
-        if (task_table[i] == NULL) {//找到一个没有使用的PCB块
-            task_t *task = (task_t *)alloc_kpage(1);
-            memset(task, 0, PAGE_SIZE);
-            task->pid = i;
-            // task->ppid = -1;
-            task_table[i] = task;
-            return task_table[i];
+task_t *task_find(pid_t pid) {
+    list_t *list = &pid_hash[pid % PID_HASH_NR];
+    for (list_node_t *node = list->head.next; node != &list->tail; node = node->next) {
+        task_t *task = element_entry(task_t, hnode, node);
+        if (task->pid == pid) {
+            return task;
         }
     }
-    panic("No more PCBs\n");
+    return NULL;
+}
+
+//分配一页PCB块和一个 pid，进程数量达到上限时返回 NULL
+static task_t *get_free_task() {
+    if (task_count >= TASK_NR_MAX) {
+        return NULL;
+    }
+    pid_t pid = bitmap_alloc_from(&pid_map, (last_pid + 1) % PID_MAX);
+    assert(pid != EOF);
+    last_pid = pid;
+    task_count++;
+
+    task_t *task = (task_t *)alloc_kpage(1);
+    memset(task, 0, PAGE_SIZE);
+    task->pid = pid;
+    return task;
+}
+
+//PCB块填好之后加入 pid 哈希表
+static void task_insert(task_t *task) {
+    list_init(&task->children);
+    list_init(&task->locks);
+    task->blocked_on = NULL;
+    list_insert_after(&pid_hash[task->pid % PID_HASH_NR].head, &task->hnode);
+}
+
+//释放PCB块和 pid
+static void put_task(task_t *task) {
+    list_remove(&task->hnode);
+    bitmap_set(&pid_map, task->pid, false);
+    task_count--;
+    free_kpage((uint32)task, 1);
 }
 
 static task_t* task_create(target_t target, const char* name, uint32 priority, uint32 uid) {
     task_t *task = get_free_task();
+    if (!task) {
+        panic("No more PCBs\n");
+    }
     uint32 stack = (uint32)task + PAGE_SIZE - sizeof(task_frame_t);
     
     strcpy(task->name, name);
     task->stack = (uint32 *)stack;//指向该进程的内核栈
     task->priority = priority;//优先级
+    task->base_priority = priority;
     task->ticks = task->priority;//时间片
     task->jiffies = 0;
     task->state = TASK_READY;//就绪
@@ -202,6 +322,10 @@ static task_t* task_create(target_t target, const char* name, uint32 priority, u
     task->files[STDOUT_FILENO]->count++;
     task->files[STDERR_FILENO]->count++;
 
+    task->group = task;
+    task->threads = 1;
+    wait_queue_init(&task->thread_wait);
+
     task->magic = ONIX_MAGIC;
     
     task_frame_t *frame = (task_frame_t *)stack;
@@ -211,31 +335,59 @@ static task_t* task_create(target_t target, const char* name, uint32 priority, u
     frame->ebp = 0x44444444;
     frame->eip = (void *)target;
 
+    task_insert(task);
+    if (idle_task) {//内核线程都是 idle 的子进程
+        list_insert_after(&idle_task->children.head, &task->sibling);
+    }
+    return task;
+}
+
+task_t *kernel_thread(target_t target, const char *name, uint32 priority) {
+    task_t *task = task_create(target, name, priority, KERNEL_USER);
+    task_t *current = running_task();
+    if (current != idle_task && current->pid != EOF) {//由创建它的线程 waitpid 回收，启动时创建的交给 idle
+        list_remove(&task->sibling);
+        task->ppid = current->pid;
+        list_insert_after(&current->children.head, &task->sibling);
+    }
+    ready_enqueue(task);
     return task;
 }
 
 static void task_setup() {
     task_t *task = running_task();
+    task->pid = EOF;//启动时的上下文不在进程表中
     task->magic = ONIX_MAGIC;
+    task->group = task;
+    task->base_priority = task->priority;
+    list_init(&task->locks);
     task->ticks = 1;//必须设置为1，这样在时钟中断的时候才能够触发schedule
     task->state = TASK_RUNNING;
-    memset(task_table, 0, sizeof(task_table));
 }
 
 void task_init() {
+    vmap_cache = kmem_cache_create("vmap", sizeof(bitmap_t), NULL);
     list_init(&block_list);
-    list_init(&sleep_list);
+    for (size_t i = 0; i < PRIORITY_NR; ++i) {
+        list_init(&ready_list[i]);
+    }
+    for (size_t i = 0; i < PID_HASH_NR; ++i) {
+        list_init(&pid_hash[i]);
+    }
+    bitmap_init(&pid_map, (char *)alloc_kpage(1), PID_MAX / 8, 0);
+    info_install("schedstat", sched_show);
+    futex_init();
     task_setup();
     idle_task = task_create(idle_thread, "idle_thread", 1, KERNEL_USER);
-    task_create(init_thread, "init_thread", 5, NORMAL_USER);
-    task_create(test_thread, "test_thread", 5, KERNEL_USER);
+    ready_enqueue(task_create(init_thread, "init_thread", 5, NORMAL_USER));
+    ready_enqueue(task_create(test_thread, "test_thread", 5, KERNEL_USER));
 }
 
 void task_to_user_mode()
 {
     task_t *task = running_task();    
     //创建用户进程的虚拟内存位图
-    task->vmap = kmalloc(sizeof(bitmap_t));
+    task->vmap = kmem_cache_alloc(vmap_cache);
     void *buf = (void *)alloc_kpage(1);
     bitmap_init(task->vmap, buf, USER_MMAP_SIZE / PAGE_SIZE / 8, USER_MMAP_ADDR / PAGE_SIZE);
     //创建用户进程页表
@@ -278,6 +430,28 @@ pid_t sys_getpid() {
     return current->pid;
 }
 
+int sys_ps(task_info_t *info, int count) {
+    int nr = 0;
+    for (size_t i = 0; i < PID_HASH_NR && nr < count; ++i) {
+        list_t *list = &pid_hash[i];
+        for (list_node_t *node = list->head.next; node != &list->tail && nr < count; node = node->next) {
+            task_t *task = element_entry(task_t, hnode, node);
+            task_info_t *ptr = &info[nr++];
+            ptr->pid = task->pid;
+            ptr->ppid = task->ppid;
+            ptr->state = task->state;
+            ptr->priority = task->priority;
+            ptr->uid = task->uid;
+            ptr->cpu_ticks = task->cpu_ticks;
+            ptr->nvcsw = task->nvcsw;
+            ptr->nivcsw = task->nivcsw;
+            ptr->block_ticks = task->block_ticks;
+            strncpy(ptr->name, task->name, sizeof(ptr->name));
+        }
+    }
+    return nr;
+}
+
 pid_t sys_getppid() {
     assert(!get_interrupt_state());//已经关闭了中断
     task_t *current = running_task();
@@ -318,25 +492,61 @@ static void task_build_stack(task_t *task) {
     task->stack = (uint32 *)frame;
 }
 
+//线程 fork 时，子进程的地址空间、文件描述符表和当前目录来自主线程
+static void task_copy_group(task_t *child, task_t *group) {
+    child->pde = group->pde;
+    child->vmap = group->vmap;
+    child->text = group->text;
+    child->data = group->data;
+    child->end = group->end;
+    child->brk = group->brk;
+    child->pwd = group->pwd;
+    child->ipwd = group->ipwd;
+    child->iroot = group->iroot;
+    child->iexec = group->iexec;
+    child->umask = group->umask;
+    memcpy(child->files, group->files, sizeof(child->files));
+    memcpy(child->regions, group->regions, sizeof(child->regions));
+}
+
 pid_t task_fork() {
     task_t *task = running_task();
+    task_t *group = task->group;
 
     assert(task->node.next == NULL && task->node.prev == NULL && task->state == TASK_RUNNING);
 
     task_t *child = get_free_task();
+    if (!child) {//进程数量达到上限
+        return EOF;
+    }
     pid_t pid = child->pid;//子进程ID
     memcpy(child, task, PAGE_SIZE);
 
     child->pid = pid;
     child->ppid = task->pid;
+    task_insert(child);
+    list_insert_after(&task->children.head, &child->sibling);
     child->state = TASK_READY;
+    child->priority = child->base_priority;//父进程可能因为持有互斥量被提升了优先级
     child->ticks = child->priority;
+    child->cpu_ticks = 0;
+    child->nvcsw = 0;
+    child->nivcsw = 0;
+    child->block_ticks = 0;
+    if (task != group) {
+        task_copy_group(child, group);
+    }
+    child->group = child;
+    child->threads = 1;
+    child->killed = false;
+    wait_queue_init(&child->thread_wait);
+    child->ustack = 0;
 
     //分配子进程的虚拟内存位图
-    child->vmap = kmalloc(sizeof(bitmap_t));
-    memcpy(child->vmap, task->vmap, sizeof(bitmap_t));//并将父进程的vmap拷贝一份
+    child->vmap = kmem_cache_alloc(vmap_cache);
+    memcpy(child->vmap, group->vmap, sizeof(bitmap_t));//并将父进程的vmap拷贝一份
     void *buf = (void *)alloc_kpage(1);
-    memcpy(buf, task->vmap->bits, PAGE_SIZE);
+    memcpy(buf, group->vmap->bits, PAGE_SIZE);
     child->vmap->bits = buf;
 
     //拷贝页目录
@@ -344,14 +554,16 @@ pid_t task_fork() {
 
     //拷贝pwd
     child->pwd = (char *)alloc_kpage(1);
-    strncpy(child->pwd, task->pwd, PAGE_SIZE);
+    strncpy(child->pwd, group->pwd, PAGE_SIZE);
 
     //工作目录引用加1
-    task->ipwd->count++;
-    task->iroot->count++;
-    if (task->iexec) {
-        task->iexec->count++;
+    group->ipwd->count++;
+    group->iroot->count++;
+    if (group->iexec) {
+        group->iexec->count++;
     }
+    //文件映射区域引用加1
+    region_copy(child);
     //文件描述符引用计数加1
     for (size_t i = 0; i < TASK_FILE_NR; ++i) {
         file_t *file = child->files[i];
@@ -361,48 +573,160 @@ pid_t task_fork() {
     }
 
     task_build_stack(child);
+    ready_enqueue(child);
+
+    return child->pid;
+}
+
+//从 USER_STACK_BOTTOM 向下找一段没有映射的地址作为线程栈
+static uint32 thread_stack_alloc(task_t *group) {
+    for (uint32 top = USER_STACK_BOTTOM; top - THREAD_STACK_SIZE >= USER_MMAP_ADDR; top -= THREAD_STACK_SIZE) {
+        uint32 bottom = top - THREAD_STACK_SIZE;
+        bool used = false;
+        for (uint32 page = bottom; page < top && !used; page += PAGE_SIZE) {
+            used = bitmap_test(group->vmap, page / PAGE_SIZE);
+        }
+        if (!used) {
+            return (uint32)sys_mmap((void *)bottom, THREAD_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE, EOF, 0);
+        }
+    }
+    return EOF;
+}
+
+pid_t sys_clone(uint32 entry, uint32 arg1, uint32 arg2) {
+    task_t *task = running_task();
+    task_t *group = task->group;
+    assert(task->uid != KERNEL_USER);
+    if (task->killed) {//进程正在退出
+        return EOF;
+    }
+
+    uint32 stack = thread_stack_alloc(group);
+    if (stack == EOF) {
+        return EOF;
+    }
+    task_t *child = get_free_task();
+    if (!child) {//进程数量达到上限
+        sys_munmap((void *)stack, THREAD_STACK_SIZE);
+        return EOF;
+    }
+    pid_t pid = child->pid;
+    memcpy(child, task, PAGE_SIZE);//页目录和进程的其它资源都和主线程共享，不增加引用
+
+    child->pid = pid;
+    child->ppid = task->pid;//由创建者 waitpid 回收
+    task_insert(child);
+    list_insert_after(&task->children.head, &child->sibling);
+    child->state = TASK_READY;
+    child->priority = child->base_priority;//父进程可能因为持有互斥量被提升了优先级
+    child->ticks = child->priority;
+    child->cpu_ticks = 0;
+    child->nvcsw = 0;
+    child->nivcsw = 0;
+    child->block_ticks = 0;
+    child->group = group;
+    child->threads = 0;
+    wait_queue_init(&child->thread_wait);
+    child->futex = 0;
+    child->ustack = stack;
+    group->threads++;
+
+    //线程栈上放入入口函数的两个参数和一个空的返回地址
+    uint32 *esp = (uint32 *)(stack + THREAD_STACK_SIZE);
+    *(--esp) = arg2;
+    *(--esp) = arg1;
+    *(--esp) = 0;
+
+    task_build_stack(child);
+    intr_frame_t *iframe = (intr_frame_t *)((uint32)child + PAGE_SIZE - sizeof(intr_frame_t));
+    iframe->eip = entry;
+    iframe->esp = (uint32)esp;
+    ready_enqueue(child);
 
+    LOGK("task %d clone thread %d stack 0x%p\n", task->pid, child->pid, stack);
     return child->pid;
 }
 
+//主线程退出时结束进程中的其它线程
+//线程在返回用户态时退出，可以打断的睡眠和 waitpid 直接唤醒，其它阻塞等它自己返回
+static void task_kill_group(task_t *group) {
+    for (size_t i = 0; i < PID_HASH_NR; ++i) {
+        list_t *list = &pid_hash[i];
+        for (list_node_t *node = list->head.next; node != &list->tail; node = node->next) {
+            task_t *task = element_entry(task_t, hnode, node);
+            if (task->group != group || task == group || task->state == TASK_DEAD) {
+                continue;
+            }
+            task->killed = true;
+            if ((task->state == TASK_BLOCKED && task->killable) || task->state == TASK_WAITING) {
+                task->futex = 0;
+                task_unblock(task);
+            }
+        }
+    }
+}
+
+void task_exit_check(intr_frame_t *frame) {
+    task_t *task = running_task();
+    if (task->killed && (frame->cs & 3) == 3) {
+        task_exit(0);
+    }
+}
+
 void task_exit(int status) {//exit系统调用处理函数
     task_t *task = running_task();
 
     assert(task->node.next == NULL && task->node.prev == NULL && task->state == TASK_RUNNING);
 
-    task->state = TASK_DEAD;
-    task->status = status;
+    task_t *group = task->group;
+    if (task != group) {//线程只释放自己的用户栈
+        sys_munmap((void *)task->ustack, THREAD_STACK_SIZE);
+        group->threads--;
+        wake_all(&group->thread_wait);
+    } else {
+        task_kill_group(task);
+        while (task->threads > 1) {//等其它线程都退出之后才能释放共享的资源
+            wait_sleep(&task->thread_wait);
+        }
 
-    free_pde();//释放当前进程的页目录，页表，物理页
-    free_kpage((uint32)task->vmap->bits, 1);//释放虚拟位图缓冲区
-    kfree(task->vmap);
+        if (task->uid != KERNEL_USER) {//内核线程使用内核的页目录和位图
+            region_free(task);//写回共享文件映射，释放映射区域
+            free_pde();//释放当前进程的页目录，页表，物理页
+            free_kpage((uint32)task->vmap->bits, 1);//释放虚拟位图缓冲区
+            kmem_cache_free(vmap_cache, task->vmap);
+        }
 
-    free_kpage((uint32)task->pwd, 1);
-    iput(task->ipwd);
-    iput(task->iroot);
-    iput(task->iexec);
+        free_kpage((uint32)task->pwd, 1);
+        iput(task->ipwd);
+        iput(task->iroot);
+        iput(task->iexec);
 
-    //文件描述符的引用计数减1
-    for (size_t i = 0; i < TASK_FILE_NR; ++i) {
-        file_t *file = task->files[i];
-        if (file) {
-            close(i);
+        //文件描述符的引用计数减1
+        for (size_t i = 0; i < TASK_FILE_NR; ++i) {
+            file_t *file = task->files[i];
+            if (file) {
+                close(i);
+            }
         }
     }
 
-    for (size_t i = 0; i < NR_TASKS; ++i) {//将自己的子进程的父进程赋值为自己的父进程
-        task_t *child = task_table[i];
-        if (!child) {
-            continue;
-        }
+    //释放资源时可能阻塞，最后再设置状态
+    task->state = TASK_DEAD;
+    task->status = status;
 
-        if (child->ppid != task->pid) {
+    task_t *parent = task_find(task->ppid);
+    assert(parent);
+    while (!list_empty(&task->children)) {//将自己的子进程交给自己的父进程
+        task_t *child = element_entry(task_t, sibling, list_pop(&task->children));
+        if (child->group == task && child != task) {//线程都已经退出，由主线程直接回收，不交给父进程
+            assert(child->state == TASK_DEAD);
+            put_task(child);
             continue;
         }
         child->ppid = task->ppid;
+        list_insert_after(&parent->children.head, &child->sibling);
     }
     LOGK("task %s 0x%p exit....\n", task->name, task);
-    task_t *parent = task_table[task->ppid];
     if (parent->state == TASK_WAITING && (parent->waitpid == task->pid || parent->waitpid == -1)) {
         task_unblock(parent);
     }
@@ -416,27 +740,21 @@ pid_t task_waitpid(pid_t pid, int32 *status) {//pid为-1时，等待所有子进
 
     while (true) {
         bool has_child =false;
-        for (size_t i = 2; i < NR_TASKS; ++i) {
-            task_t *ptr = task_table[i];
-            if (!ptr) {
-                continue;
-            }
-            if (ptr->ppid != task->pid) {
-                continue;
-            }
+        list_t *list = &task->children;
+        for (list_node_t *node = list->head.next; node != &list->tail; node = node->next) {
+            task_t *ptr = element_entry(task_t, sibling, node);
             if (pid != ptr->pid && pid != -1) {
                 continue;
             }
 
             if (ptr->state == TASK_DEAD) {//等待的这个子进程已经exit
                 child = ptr;
-                task_table[i] = NULL;
                 goto rollback;
             }
             has_child = true;
             //接下来继续的循环只在pid为-1时有效果
         }
-        if (has_child) {//子进程还没有exit
+        if (has_child && !task->killed) {//子进程还没有exit，所在进程退出时不再等待
             task->waitpid = pid;//可能为-1，或者其中一个子进程的pid
             task_block(task, NULL, TASK_WAITING);//将自己阻塞
             continue;
@@ -448,6 +766,7 @@ pid_t task_waitpid(pid_t pid, int32 *status) {//pid为-1时，等待所有子进
 rollback:
     *status = child->status;
     uint32 ret = child->pid;
-    free_kpage((uint32)child, 1);//释放PCB块
+    list_remove(&child->sibling);
+    put_task(child);//释放PCB块和 pid
     return ret;//返回释放的子进程pid
 }
\ No newline at end of file
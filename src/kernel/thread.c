@@ -12,11 +12,16 @@
 static uint32 count = 0;
 
 void idle_thread() {
-    set_interrupt_state(true);//开中断
     while (true) {
+        set_interrupt_state(false);
+        clock_idle_enter();//没有别的进程可以执行，时钟到下一个定时器到期时才中断
         asm volatile(
+            "sti\n"//sti 之后的一条指令执行完才响应中断，不会错过唤醒
             "hlt\n"//让cpu占停一会，等待中断唤醒cpu
         );
+        set_interrupt_state(false);
+        clock_idle_exit();
+        schedule();//中断可能唤醒了别的进程
     }
 }
 
@@ -26,8 +31,65 @@ void init_thread() {
     task_to_user_mode();
 }
 
+#ifdef ONIX_SELFTEST
+//优先级继承自测：低优先级线程持有互斥量时，中优先级线程一直占用 CPU，
+//高优先级线程等待的时间应该只取决于持有者剩下的工作量，而不是中优先级线程什么时候让出 CPU
+#define PI_WORK 20 //低优先级线程持有互斥量期间要执行的时间片
+
+static mutex_t pi_mutex;
+static volatile bool pi_done;
+
+static void pi_low_thread() {
+    set_interrupt_state(true);
+    mutex_lock(&pi_mutex);
+    uint32 start = running_task()->cpu_ticks;
+    while (running_task()->cpu_ticks - start < PI_WORK);
+    mutex_unlock(&pi_mutex);
+    set_interrupt_state(false);
+    task_exit(0);
+}
+
+static void pi_mid_thread() {
+    set_interrupt_state(true);
+    while (!pi_done);
+    set_interrupt_state(false);
+    task_exit(0);
+}
+
+static void mutex_inherit_test() {
+    mutex_init(&pi_mutex);
+    pi_done = false;
+
+    task_t *current = running_task();
+    pid_t low = kernel_thread(pi_low_thread, "pi_low", 1)->pid;
+    set_interrupt_state(false);
+    while (!pi_mutex.holder) {//等低优先级线程持有互斥量
+        task_sleep(10);
+    }
+    pid_t mid = kernel_thread(pi_mid_thread, "pi_mid", 3)->pid;
+
+    uint32 start = jiffies;
+    mutex_lock(&pi_mutex);
+    uint32 latency = jiffies - start;
+    mutex_unlock(&pi_mutex);
+    pi_done = true;
+
+    int32 status;
+    task_waitpid(low, &status);//回收测试线程
+    task_waitpid(mid, &status);
+    set_interrupt_state(true);
+
+    //等待时间和机器的负载有关，只报告结果
+    LOGK("priority %d wait mutex %d ticks, holder work %d ticks: %s\n", current->priority, latency, PI_WORK,
+         latency <= PI_WORK * 2 ? "pass" : "FAIL");
+}
+#endif
+
 void test_thread() {
     set_interrupt_state(true);//开中断
+#ifdef ONIX_SELFTEST
+    mutex_inherit_test();
+#endif
     while (true) {
     }
 }
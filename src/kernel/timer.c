@@ -0,0 +1,119 @@
+#include "../include/timer.h"
+#include "../include/clock.h"
+#include "../include/assert.h"
+#include "../include/interrupt.h"
+
+//分层时间轮：第一层每个槽一个时间片，之后每层的一个槽是上一层转一圈的时间
+#define TVR_BITS 8
+#define TVN_BITS 6
+#define TVR_SIZE (1 << TVR_BITS)
+#define TVN_SIZE (1 << TVN_BITS)
+#define TVR_MASK (TVR_SIZE - 1)
+#define TVN_MASK (TVN_SIZE - 1)
+#define TVN_NR 4 //8 + 4 * 6 = 32 位
+
+static list_t tv1[TVR_SIZE];
+static list_t tvn[TVN_NR][TVN_SIZE];
+static uint32 timer_jiffies;//时间轮下一个要处理的时间片
+
+//按照到期时间放入对应层的槽中
+static void timer_insert(timer_t *timer) {
+    uint32 expires = timer->expires;
+    uint32 idx = expires - timer_jiffies;
+    list_t *list;
+    if ((int32)idx < 0) {//已经过期，下一个时间片就处理
+        list = &tv1[timer_jiffies & TVR_MASK];
+    } else if (idx < TVR_SIZE) {
+        list = &tv1[expires & TVR_MASK];
+    } else {
+        size_t i = 0;
+        while (i < TVN_NR - 1 && idx >= (1u << (TVR_BITS + (i + 1) * TVN_BITS))) {
+            i++;
+        }
+        list = &tvn[i][(expires >> (TVR_BITS + i * TVN_BITS)) & TVN_MASK];
+    }
+    list_insert_before(&list->tail, &timer->node);
+}
+
+//上层的槽到时间了，将其中的定时器重新放到下层
+static uint32 cascade(size_t level) {
+    uint32 index = (timer_jiffies >> (TVR_BITS + level * TVN_BITS)) & TVN_MASK;
+    list_t *list = &tvn[level][index];
+    while (!list_empty(list)) {
+        timer_t *timer = element_entry(timer_t, node, list_pop(list));
+        timer_insert(timer);
+    }
+    return index;
+}
+
+void timer_init() {
+    for (size_t i = 0; i < TVR_SIZE; ++i) {
+        list_init(&tv1[i]);
+    }
+    for (size_t i = 0; i < TVN_NR; ++i) {
+        for (size_t j = 0; j < TVN_SIZE; ++j) {
+            list_init(&tvn[i][j]);
+        }
+    }
+    timer_jiffies = jiffies;
+}
+
+void timer_setup(timer_t *timer, timer_handler_t handler, void *arg) {
+    timer->node.prev = NULL;
+    timer->node.next = NULL;
+    timer->expires = 0;
+    timer->handler = handler;
+    timer->arg = arg;
+    timer->active = false;
+}
+
+void timer_add(timer_t *timer, uint32 expires) {
+    bool intr = interrupt_disable();
+    assert(!timer->active);
+    timer->expires = expires;
+    timer->active = true;
+    timer_insert(timer);
+    set_interrupt_state(intr);
+}
+
+void timer_del(timer_t *timer) {
+    bool intr = interrupt_disable();
+    if (timer->active) {
+        list_remove(&timer->node);
+        timer->active = false;
+    }
+    set_interrupt_state(intr);
+}
+
+void timer_run() {
+    assert(!get_interrupt_state());
+    while ((int32)(jiffies - timer_jiffies) >= 0) {
+        uint32 index = timer_jiffies & TVR_MASK;
+        if (!index) {//第一层转完一圈，从上层取出接下来一圈的定时器
+            for (size_t i = 0; i < TVN_NR; ++i) {
+                if (cascade(i)) {
+                    break;
+                }
+            }
+        }
+        list_t *list = &tv1[index];
+        timer_jiffies++;
+        while (!list_empty(list)) {
+            timer_t *timer = element_entry(timer_t, node, list_pop(list));
+            timer->active = false;
+            timer->handler(timer);
+        }
+    }
+}
+
+uint32 timer_idle(uint32 count) {
+    assert(count > 0);
+    uint32 i;
+    for (i = 0; i < count; ++i) {
+        uint32 index = (timer_jiffies + i) & TVR_MASK;
+        if (!index || !list_empty(&tv1[index])) {//有定时器到期，或者需要从上层级联
+            break;
+        }
+    }
+    return i < count ? i + 1 : count;
+}
@@ -0,0 +1,43 @@
+#include "../include/wait.h"
+#include "../include/tasks.h"
+#include "../include/interrupt.h"
+#include "../include/assert.h"
+
+void wait_queue_init(wait_queue_t *wq) {
+    list_init(&wq->waiters);
+}
+
+void wait_sleep(wait_queue_t *wq) {
+    assert(!get_interrupt_state());//检查条件和阻塞之间不能被中断打断，否则会丢失唤醒
+    task_block(running_task(), &wq->waiters, TASK_BLOCKED);
+}
+
+bool wait_sleep_killable(wait_queue_t *wq) {
+    task_t *task = running_task();
+    if (task->killed) {
+        return false;
+    }
+    task->killable = true;
+    wait_sleep(wq);
+    task->killable = false;
+    return !task->killed;
+}
+
+bool wake_one(wait_queue_t *wq) {
+    bool intr = interrupt_disable();
+    bool ret = false;
+    if (!list_empty(&wq->waiters)) {
+        task_t *task = element_entry(task_t, node, wq->waiters.tail.prev);//队尾的进程等待最久
+        assert(task->magic == ONIX_MAGIC);
+        task_unblock(task);
+        ret = true;
+    }
+    set_interrupt_state(intr);
+    return ret;
+}
+
+void wake_all(wait_queue_t *wq) {
+    bool intr = interrupt_disable();
+    while (wake_one(wq));
+    set_interrupt_state(intr);
+}
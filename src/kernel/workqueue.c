@@ -0,0 +1,68 @@
+#include "../include/workqueue.h"
+#include "../include/tasks.h"
+#include "../include/wait.h"
+#include "../include/list.h"
+#include "../include/interrupt.h"
+#include "../include/assert.h"
+#include "../include/debug.h"
+
+#define WORKER_NR 2 //工作线程数量
+#define WORK_NR 64 //最多同时排队的工作数量
+#define WORKER_PRIORITY 3 //比用户进程低
+
+typedef struct work_t {
+    list_node_t node;
+    work_func_t func;
+    void *arg;
+} work_t;
+
+//工作项从静态数组分配，中断处理函数中也可以使用
+static work_t works[WORK_NR];
+static list_t free_list;//空闲的工作项
+static list_t work_list;//等待执行的工作，新加入的在队首
+static wait_queue_t worker_wait;//没有工作时等待的工作线程
+
+bool queue_work(work_func_t func, void *arg) {
+    bool intr = interrupt_disable();
+    if (list_empty(&free_list)) {
+        LOGK("work queue full, drop work 0x%p\n", func);
+        set_interrupt_state(intr);
+        return false;
+    }
+    work_t *work = element_entry(work_t, node, list_pop(&free_list));
+    work->func = func;
+    work->arg = arg;
+    list_insert_after(&work_list.head, &work->node);
+    wake_one(&worker_wait);
+    set_interrupt_state(intr);
+    return true;
+}
+
+//工作线程和系统调用一样在关中断的状态下执行工作，工作中阻塞时会调度别的进程
+static void worker_thread() {
+    while (true) {
+        set_interrupt_state(false);
+        while (list_empty(&work_list)) {
+            wait_sleep(&worker_wait);
+        }
+        work_t *work = element_entry(work_t, node, list_popback(&work_list));//先加入的先执行
+        work_func_t func = work->func;
+        void *arg = work->arg;
+        list_insert_after(&free_list.head, &work->node);
+
+        func(arg);
+    }
+}
+
+void workqueue_init() {
+    list_init(&free_list);
+    list_init(&work_list);
+    wait_queue_init(&worker_wait);
+    for (size_t i = 0; i < WORK_NR; ++i) {
+        list_insert_after(&free_list.head, &works[i].node);
+    }
+    for (size_t i = 0; i < WORKER_NR; ++i) {
+        kernel_thread(worker_thread, "worker", WORKER_PRIORITY);
+    }
+    LOGK("workqueue init with %d workers\n", WORKER_NR);
+}
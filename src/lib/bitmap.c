@@ -8,6 +8,7 @@ void bitmap_make(bitmap_t *map, char *bits, uint32 length, uint32 offset) {
     map->bits = bits;
     map->length = length;
     map->offset = offset;
+    map->hint = 0;
 }
 
 //初始化位图
@@ -42,31 +43,121 @@ void bitmap_set(bitmap_t *map, uint32 index, bool value) {
         map->bits[bytes] |= (1 << bits);//置1
     } else {
         map->bits[bytes] &= ~(1 << bits);//置0
+        if (idx < map->hint) {//释放的位在提示之前，下次从这里开始扫描
+            map->hint = idx;
+        }
     }
 }
 
-//从位图中得到连续的count位
-int bitmap_scan(bitmap_t *map, uint32 count) {
-    int start = EOF; //标记目标开始的位置
-    uint32 bits_left = map->length * 8;
-    uint32 counter = 0;
-    for (uint32 next_bit = 0; next_bit < bits_left; ++next_bit) {
-        if (!bitmap_test(map, map->offset + next_bit)) {
-            counter++;
-        } else {
-            counter = 0;
+//返回 word 中最低的 1 所在的位，word 不能为 0
+static _inline uint32 bit_scan_forward(uint32 word) {
+    uint32 index;
+    asm volatile("bsfl %1, %0\n" : "=r"(index) : "rm"(word));
+    return index;
+}
+
+//取出位图第 widx 个 32 位字，超出位图长度的位视为 1
+static uint32 bitmap_word(bitmap_t *map, uint32 widx) {
+    uint32 bytes = widx * 4;
+    if (bytes + 4 <= map->length) {
+        return *(uint32 *)(map->bits + bytes);
+    }
+    uint32 word = 0xffffffff;
+    for (size_t i = 0; bytes + i < map->length; ++i) {
+        word &= ~(0xffu << (i * 8));
+        word |= (uint32)(uint8)map->bits[bytes + i] << (i * 8);
+    }
+    return word;
+}
+
+//从 from 开始找到第一个为 0 的位，找不到返回 total
+static uint32 bitmap_find_zero(bitmap_t *map, uint32 from, uint32 total) {
+    while (from < total) {
+        uint32 widx = from / 32;
+        uint32 word = bitmap_word(map, widx);
+        word |= (1u << (from % 32)) - 1;//忽略 from 之前的位
+        if (word != 0xffffffff) {
+            return widx * 32 + bit_scan_forward(~word);
         }
-        if (counter == count) {
-            start = next_bit - count + 1;
-            break;
+        from = (widx + 1) * 32;//整个字都被占用，直接跳过
+    }
+    return total;
+}
+
+//找到 [from, to) 中第一个为 1 的位，找不到返回 to
+static uint32 bitmap_find_one(bitmap_t *map, uint32 from, uint32 to) {
+    while (from < to) {
+        uint32 widx = from / 32;
+        uint32 word = bitmap_word(map, widx);
+        word &= ~((1u << (from % 32)) - 1);//忽略 from 之前的位
+        if (word) {
+            uint32 bit = widx * 32 + bit_scan_forward(word);
+            return bit < to ? bit : to;
         }
+        from = (widx + 1) * 32;
     }
-    if (start != EOF) {//找到
-        for (uint32 next_bit = 0; next_bit < count; ++next_bit) {
-            bitmap_set(map, map->offset + start + next_bit, true);//将找到的位全部置1
+    return to;
+}
+
+//将 [start, start + count) 的位全部置1
+static void bitmap_fill(bitmap_t *map, uint32 start, uint32 count) {
+    uint32 end = start + count;
+    //开头不满一个字节的部分
+    while (start < end && (start % 8)) {
+        map->bits[start / 8] |= (1 << (start % 8));
+        start++;
+    }
+    //中间整字节的部分
+    uint32 bytes = (end - start) / 8;
+    memset(map->bits + start / 8, 0xff, bytes);
+    start += bytes * 8;
+    //结尾不满一个字节的部分
+    while (start < end) {
+        map->bits[start / 8] |= (1 << (start % 8));
+        start++;
+    }
+}
+
+//从位图中得到连续的count位
+int bitmap_scan(bitmap_t *map, uint32 count) {
+    assert(count > 0);
+    uint32 total = map->length * 8;
+
+    //提示之前的位都已经被占用，从第一个空闲位开始扫描
+    uint32 start = bitmap_find_zero(map, map->hint, total);
+    map->hint = start;
+
+    while (start + count <= total) {
+        uint32 used = bitmap_find_one(map, start, start + count);
+        if (used == start + count) {//找到
+            bitmap_fill(map, start, count);//将找到的位全部置1
+            if (start == map->hint) {
+                map->hint = start + count;
+            }
+            return start + map->offset;
         }
-        return start + map->offset;
+        start = bitmap_find_zero(map, used + 1, total);
     }
     //未找到
-    return start;
+    return EOF;
+}
+
+//从位 from（包含偏移）开始找一个空闲位并置 1，找到末尾后回到开头继续找到 from 之前
+//from 超出位图时从开头找，返回分配的位（包含偏移），没有空闲位返回 EOF
+int bitmap_alloc_from(bitmap_t *map, uint32 from) {
+    assert(from >= map->offset);
+    uint32 total = map->length * 8;
+    from -= map->offset;
+    if (from >= total) {
+        from = 0;
+    }
+    uint32 idx = bitmap_find_zero(map, from, total);
+    if (idx == total) {//后面已经全部被占用，回到开头找
+        idx = bitmap_find_zero(map, 0, from);
+        if (idx >= from) {
+            return EOF;
+        }
+    }
+    bitmap_set(map, idx + map->offset, true);
+    return idx + map->offset;
 }
@@ -87,6 +87,10 @@ int munmap(void *addr, size_t length) {
     return _syscall2(SYS_NR_MUNMAP, (uint32)addr, (uint32)length);
 }
 
+int msync(void *addr, size_t length, int flags) {
+    return _syscall3(SYS_NR_MSYNC, (uint32)addr, (uint32)length, (uint32)flags);
+}
+
 
 //打开文件
 fd_t open(char *filename, int flags, int mode) {
@@ -220,6 +224,31 @@ int execve(char *filename, char *argv[], char *envp[]) {
     return _syscall3(SYS_NR_EXECVE, (uint32)filename, (uint32)argv, (uint32)envp);
 }
 
+int sync() {
+    return _syscall0(SYS_NR_SYNC);
+}
+
+int fsync(fd_t fd) {
+    return _syscall1(SYS_NR_FSYNC, (uint32)fd);
+}
+
+//线程入口，线程函数返回后退出线程
+static void thread_start(void (*fn)(void *), void *arg) {
+    fn(arg);
+    exit(0);
+}
+
+pid_t thread_create(void (*fn)(void *), void *arg) {
+    return _syscall3(SYS_NR_CLONE, (uint32)thread_start, (uint32)fn, (uint32)arg);
+}
+
+int futex(uint32 *addr, int op, uint32 val) {
+    return _syscall3(SYS_NR_FUTEX, (uint32)addr, (uint32)op, (uint32)val);
+}
+
+int ps(task_info_t *info, int count) {
+    return _syscall2(SYS_NR_PS, (uint32)info, (uint32)count);
+}
 
 fd_t dup(fd_t oldfd) {
     return _syscall1(SYS_NR_DUP, (uint32)oldfd);